@@ -0,0 +1,101 @@
+/*!***************************************************************************
+@file    bench-bands.cpp
+@author  mc-w
+@date    10/19/2026
+@brief   Times full-screen updates as encoding is split across more bands.
+
+Draws a frame where every cell differs from the last, in a different color
+each, and renders it into memory, over and over. Runs with 1, 2, 3... up to
+the given number of band threads, printing the time per frame and how much
+faster that is than encoding on one thread. Each band after the first starts
+by moving the cursor and setting colors again, so a few more bytes per frame
+is expected as threads are added.
+
+  bench_bands [max threads] [width] [height] [frames per run]
+
+@copyright See LICENSE.md
+*****************************************************************************/
+#include "console-utils.hpp"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+using namespace RConsole;
+
+
+// Fills the whole canvas with characters and colors that all change from frame to frame.
+static void drawFrame(Terminal &terminal, unsigned int frame)
+{
+  const unsigned int width = terminal.GetConsoleWidht();
+  const unsigned int height = terminal.GetConsoleHeight();
+  for (unsigned int y = 0; y < height; ++y)
+  {
+    for (unsigned int x = 0; x < width; ++x)
+    {
+      const unsigned int v = x + y * 7 + frame * 13;
+      terminal.Draw(static_cast<char32_t>('!' + v % 94), static_cast<float>(x), static_cast<float>(y),
+                    CellColor::Rgb(static_cast<uint8_t>(v), static_cast<uint8_t>(v * 3), static_cast<uint8_t>(frame)),
+                    CellColor::Indexed(static_cast<uint8_t>(v * 5 + frame)));
+    }
+  }
+}
+
+
+// One run: renders frames with the given number of band threads. Returns milliseconds
+// per frame, and the bytes written per frame.
+static double run(unsigned int threads, unsigned int width, unsigned int height, unsigned int frames, size_t &bytes)
+{
+  Terminal terminal(width, height);
+  MemorySink sink;
+  terminal.SetSink(&sink);
+  terminal.SetColorDepth(DEPTH_TRUECOLOR);
+  terminal.SetBands(threads);
+
+  // The first frame sets the screen up, so it isn't timed.
+  drawFrame(terminal, 0);
+  terminal.Update();
+  sink.Clear();
+
+  bytes = 0;
+  double seconds = 0;
+  for (unsigned int frame = 1; frame <= frames; ++frame)
+  {
+    drawFrame(terminal, frame);
+    const auto start = std::chrono::steady_clock::now();
+    terminal.Update();
+    seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    bytes += sink.GetSize();
+    sink.Clear();
+  }
+
+  bytes /= frames;
+  terminal.SetSink(nullptr);
+  return seconds * 1000 / frames;
+}
+
+
+// Runs every thread count and prints how each compares to one thread.
+int main(int argc, char *argv[])
+{
+  const unsigned int maxThreads = (argc > 1) ? std::stoul(argv[1]) : std::max(1u, std::thread::hardware_concurrency());
+  const unsigned int width = (argc > 2) ? std::stoul(argv[2]) : 400;
+  const unsigned int height = (argc > 3) ? std::stoul(argv[3]) : 120;
+  const unsigned int frames = (argc > 4) ? std::stoul(argv[4]) : 100;
+
+  std::cout << width << "x" << height << " cells, " << frames << " frames per run" << std::endl;
+  std::cout << "threads   ms/frame   speedup  bytes/frame" << std::endl;
+  double single = 0;
+  for (unsigned int threads = 1; threads <= maxThreads; ++threads)
+  {
+    size_t bytes = 0;
+    const double ms = run(threads, width, height, frames, bytes);
+    if (threads == 1)
+      single = ms;
+
+    std::cout << std::setw(7) << threads << std::fixed << std::setprecision(3)
+              << std::setw(11) << ms << std::setprecision(2) << std::setw(9) << single / ms << "x"
+              << std::setw(13) << bytes << std::endl;
+  }
+
+  return 0;
+}
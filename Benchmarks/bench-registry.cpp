@@ -0,0 +1,115 @@
+/*!***************************************************************************
+@file    bench-registry.cpp
+@author  mc-w
+@date    10/18/2026
+@brief   Times menu registry lookups as concurrent readers are added.
+
+Registers a set of menus, then runs 1, 2, 4... up to the given number of
+reader threads looking up random names for a while, first on their own and
+then with a writer registering and unregistering a menu the whole time.
+Lookups per second should grow with the readers, writer or not.
+
+  bench_registry [max readers] [menus] [seconds per run]
+
+@copyright See LICENSE.md
+*****************************************************************************/
+#include "menu-system.hpp"
+#include <iostream>
+#include <iomanip>
+#include <random>
+
+
+// One run: readers look up names until time is up, and a writer keeps changing the
+// registry if asked to. Returns lookups per second across every reader.
+static double run(size_t readers, const std::vector<std::string> &names, double seconds, bool writing)
+{
+  std::atomic<bool> running(true);
+  std::vector<size_t> lookups(readers, 0);
+  std::vector<std::thread> threads;
+
+  for (size_t r = 0; r < readers; ++r)
+  {
+    threads.emplace_back([&, r]()
+    {
+      std::mt19937 rng(static_cast<unsigned int>(r + 1));
+      size_t count = 0;
+      size_t found = 0;
+      while (running.load(std::memory_order_relaxed))
+      {
+        for (int i = 0; i < 256; ++i)
+          found += MenuRegistry::GetContainer(names[rng() % names.size()]) != nullptr;
+        count += 256;
+      }
+
+      lookups[r] = count;
+      if (found == 0)
+        std::cout << "nothing found" << std::endl;
+    });
+  }
+
+  // Registering publishes a new snapshot, which every reader then picks up once.
+  std::thread writer;
+  if (writing)
+  {
+    writer = std::thread([&]()
+    {
+      Container *extra = MenuRegistry::GetContainer(names[0]);
+      while (running.load(std::memory_order_relaxed))
+      {
+        MenuRegistry::Register("bench-extra", extra);
+        MenuRegistry::Unregister("bench-extra", extra);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    });
+  }
+
+  std::this_thread::sleep_for(std::chrono::microseconds(static_cast<int64_t>(seconds * 1000000)));
+  running = false;
+  for (std::thread &t : threads)
+    t.join();
+  if (writer.joinable())
+    writer.join();
+
+  size_t total = 0;
+  for (size_t count : lookups)
+    total += count;
+  return total / seconds;
+}
+
+
+// Runs every reader count with and without a writer, and prints the rates.
+int main(int argc, char *argv[])
+{
+  const size_t maxReaders = (argc > 1) ? std::stoul(argv[1]) : std::max<size_t>(1, std::thread::hardware_concurrency());
+  const size_t menus = (argc > 2) ? std::stoul(argv[2]) : 1000;
+  const double seconds = (argc > 3) ? std::stod(argv[3]) : 1.0;
+
+  std::vector<std::string> names;
+  std::vector<Container *> containers;
+  for (size_t i = 0; i < menus; ++i)
+  {
+    names.push_back("menu" + std::to_string(i));
+    containers.push_back(Container::Create(names.back()));
+  }
+
+  std::cout << menus << " menus, " << seconds << "s per run" << std::endl;
+  std::cout << "readers  lookups/s       per reader   with writer     per reader" << std::endl;
+  for (size_t readers = 1; ; readers = std::min(readers * 2, maxReaders))
+  {
+    const double alone = run(readers, names, seconds, false);
+    const double shared = run(readers, names, seconds, true);
+    std::cout << std::setw(7) << readers << std::fixed << std::setprecision(0)
+              << std::setw(12) << alone << std::setw(15) << alone / readers
+              << std::setw(15) << shared << std::setw(15) << shared / readers << std::endl;
+
+    if (readers >= maxReaders)
+      break;
+  }
+
+  for (size_t i = 0; i < containers.size(); ++i)
+  {
+    MenuRegistry::Unregister(names[i], containers[i]);
+    delete containers[i];
+  }
+  return 0;
+}
@@ -138,3 +138,41 @@ workspace "Stack_Menus"                      -- Solution Name
     }
 
     filter {}
+
+
+    -- [ BENCHMARKS ] --
+    -- Standalone programs timing how parts of the menus scale. Each is a single file in
+    -- Benchmarks, built against the headers in Source.
+    local benchmark_dir_root = ROOT .. "Benchmarks"
+    local function benchmark(name, executable, source)
+        project(name)
+            targetname(executable)
+            kind "ConsoleApp"
+            language "C++"
+            flags "FatalWarnings"
+            targetdir(output_dir_root)
+
+            files
+            {
+              benchmark_dir_root .. "/" .. source,
+              source_dir_root .. "/console-utils-static-init.cpp",
+            }
+            includedirs { source_dir_root }
+
+            filter { "platforms:*86" }
+                architecture "x86"
+            filter { "platforms:*64" }
+                architecture "x64"
+            filter { "configurations:Debug" }
+                defines { "DEBUG" }
+                symbols "On"
+            filter { "configurations:Release" }
+                defines { "NDEBUG" }
+                optimize "On"
+            filter { "action:gmake" }
+                buildoptions { "-std=c++14" }
+            filter {}
+    end
+
+    benchmark("BenchRegistry", "bench_registry", "bench-registry.cpp") -- Registry lookups as readers are added.
+    benchmark("BenchBands", "bench_bands", "bench-bands.cpp")          -- Full-screen updates as bands are added.
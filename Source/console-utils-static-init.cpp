@@ -4,15 +4,17 @@
 // console static inits
 namespace RConsole
 {
-#define DEFAULT_WIDTH_SIZE (rlutil::tcols() - 1)
-#define DEFAULT_HEIGHT_SIZE (rlutil::trows() - 1)
+#ifdef OS_WINDOWS
+	#define DEFAULT_WIDTH_SIZE (rlutil::tcols() - 1)
+	#define DEFAULT_HEIGHT_SIZE (rlutil::trows() - 1)
+#else
+	// Without a terminal, such as when serving menus, there is no size to ask for.
+	#define DEFAULT_WIDTH_SIZE (isatty(STDIN_FILENO) ? rlutil::tcols() - 1 : 79)
+	#define DEFAULT_HEIGHT_SIZE (isatty(STDIN_FILENO) ? rlutil::trows() - 1 : 23)
+#endif
 
 	// Static initialization in non-guaranteed order.
-	CanvasRaster Canvas::r_ = CanvasRaster(DEFAULT_WIDTH_SIZE, DEFAULT_HEIGHT_SIZE);
-	CanvasRaster Canvas::prev_ = CanvasRaster(DEFAULT_WIDTH_SIZE, DEFAULT_HEIGHT_SIZE);
+	Terminal Canvas::terminal_(DEFAULT_WIDTH_SIZE, DEFAULT_HEIGHT_SIZE);
 	bool Canvas::hasLazyInit_ = false;
-	bool Canvas::isDrawing_ = true;
-	unsigned int Canvas::width_ = DEFAULT_WIDTH_SIZE;
-	unsigned int Canvas::height_ = DEFAULT_HEIGHT_SIZE;
-	Field2D<bool> Canvas::modified_ = Field2D<bool>(DEFAULT_WIDTH_SIZE, DEFAULT_HEIGHT_SIZE);
+	volatile sig_atomic_t Canvas::resized_ = 0;
 }
@@ -607,6 +607,7 @@ struct CursorHider {
 //Colors.hpp
 ///////////////////////////////////////////////////////////////////////
 #pragma once
+#include <cstdint>          // Packed colors.
 
 
 
@@ -637,6 +638,126 @@ namespace RConsole
     //DEFAULT = rlutil::DEFAULT, // BROKEN //Added custom to the rlutil header.
     PREVIOUS_COLOR
   };
+
+  // How many colors the output can show. Richer colors are brought down to the nearest
+  // one it has when written.
+  enum ColorDepth
+  {
+    DEPTH_16,
+    DEPTH_256,
+    DEPTH_TRUECOLOR
+  };
+
+  // The color of a cell's foreground or background. Either the terminal's default, one of
+  // the 16 colors above, an index into the 256 color palette, or 24 bit RGB, packed into
+  // a word so cells still compare as plain data. PREVIOUS_COLOR is the default color.
+  class CellColor
+  {
+  public:
+    enum Kind
+    {
+      DEFAULT = 0,
+      BASIC = 1,
+      INDEXED = 2,
+      RGB = 3
+    };
+
+    // Constructors
+    CellColor();
+    CellColor(Color color);
+    static CellColor Indexed(uint8_t index);
+    static CellColor Rgb(uint8_t r, uint8_t g, uint8_t b);
+
+    // Getters
+    Kind GetKind() const;
+    uint8_t GetIndex() const;
+    uint8_t R() const;
+    uint8_t G() const;
+    uint8_t B() const;
+    uint32_t GetBits() const;
+
+    // Operators
+    bool operator ==(const CellColor &rhs) const;
+    bool operator !=(const CellColor &rhs) const;
+
+  private:
+    // Kind in the top byte, the color or index under it.
+    explicit CellColor(uint32_t bits);
+    uint32_t bits_;
+  };
+
+
+    ////////////////////////
+   // Cell Color Methods //
+  ////////////////////////
+  // The terminal's default color.
+  inline CellColor::CellColor() : bits_(0)
+  {  }
+
+
+  // One of the 16 colors, or the default for PREVIOUS_COLOR.
+  inline CellColor::CellColor(Color color)
+    : bits_((color == PREVIOUS_COLOR) ? 0 : ((BASIC << 24) | static_cast<uint32_t>(color)))
+  {  }
+
+
+  // Straight from the packed word.
+  inline CellColor::CellColor(uint32_t bits) : bits_(bits)
+  {  }
+
+
+  // An entry in the 256 color palette.
+  inline CellColor CellColor::Indexed(uint8_t index)
+  {
+    return CellColor(static_cast<uint32_t>((INDEXED << 24) | index));
+  }
+
+
+  // A 24 bit color.
+  inline CellColor CellColor::Rgb(uint8_t r, uint8_t g, uint8_t b)
+  {
+    return CellColor(static_cast<uint32_t>((RGB << 24) | (r << 16) | (g << 8) | b));
+  }
+
+
+  // What sort of color this is.
+  inline CellColor::Kind CellColor::GetKind() const
+  {
+    return static_cast<Kind>(bits_ >> 24);
+  }
+
+
+  // The Color of a basic color, or the palette index of an indexed one.
+  inline uint8_t CellColor::GetIndex() const
+  {
+    return static_cast<uint8_t>(bits_);
+  }
+
+
+  // Channels of an RGB color.
+  inline uint8_t CellColor::R() const { return static_cast<uint8_t>(bits_ >> 16); }
+  inline uint8_t CellColor::G() const { return static_cast<uint8_t>(bits_ >> 8); }
+  inline uint8_t CellColor::B() const { return static_cast<uint8_t>(bits_); }
+
+
+  // The packed word.
+  inline uint32_t CellColor::GetBits() const
+  {
+    return bits_;
+  }
+
+
+  // Colors are only equal if they are the same kind.
+  inline bool CellColor::operator ==(const CellColor &rhs) const
+  {
+    return bits_ == rhs.bits_;
+  }
+
+
+  inline bool CellColor::operator !=(const CellColor &rhs) const
+  {
+    return bits_ != rhs.bits_;
+  }
 }
 
 ///////////////////////////////////////////////////////////////////////
@@ -715,6 +836,15 @@ namespace RFuncs
 #pragma GCC diagnostic pop
 #endif
 
+#include <algorithm>        // Filling and copying tile spans.
+#include <vector>           // Tile table.
+#include <cstdint>          // uintptr_t for aligning.
+#include <cstring>          // memset, memcpy.
+#include <new>              // Placement new.
+#include <type_traits>      // Bulk copying trivial cells.
+#ifdef COMPILER_VS
+  #include <intrin.h>       // _BitScanForward64 for the dirty mask.
+#endif
 
 namespace RConsole
 {
@@ -744,11 +874,35 @@ namespace RConsole
   };
 
 
+  // A view of one row of a 2D field. It holds no cursor, so any number of views can read
+  // the same field at once, and it iterates as plain pointers.
+  template <typename T>
+  class Field2DRow
+  {
+  public:
+    // Constructor
+    Field2DRow(T *cells, unsigned int width);
+
+    // Member Functions
+    T *begin() const;
+    T *end() const;
+    unsigned int Size() const;
+    T &operator[](unsigned int x) const;
+
+  private:
+    // Variables
+    T *cells_;
+    unsigned int width_;
+  };
+
+
   // A 2D way to represent a 1D line of continuous memory.
   // The 2D Field keeps track of the current index you are at in memory, allowing really
   // cheap O(K) reading if you have the spot selected, with a single add.
   // Note that this is not guarded- if you reach the "end" of the width, it will
   // let you freely step onto the next row of the 2D array you have set up.
+  // Rows, iterators, Peek and Get(x, y) don't touch the index, and are what to read with
+  // when several threads share a field.
   template <typename T>
   class Field2D
   {
@@ -760,13 +914,18 @@ namespace RConsole
     Field2D(unsigned int w, unsigned int h);
     Field2D(unsigned int w, unsigned int h, const T defaultVal);
     Field2D &operator=(const Field2D &rhs);
+    Field2D &operator=(Field2D &&rhs);
     Field2D(const Field2D &rhs);
+    Field2D(Field2D &&rhs);
     ~Field2D();
 
 	  // Structure Info
 	  unsigned int Width() const;
 	  unsigned int Height() const;
     unsigned int Length() const;
+    unsigned int Capacity() const;
+    void Resize(unsigned int w, unsigned int h);
+    void Reshape(unsigned int w, unsigned int h);
 
     // Member Functions - Complex Manipulation
     void Zero();
@@ -780,6 +939,15 @@ namespace RConsole
     void Fill(const T &objToUse);
     void Fill(const T &objToUse, unsigned int startIndex, unsigned int endIndex);
 
+    // Stateless Access
+    unsigned int IndexOf(unsigned int x, unsigned int y) const;
+    Field2DRow<T> Row(unsigned int y);
+    Field2DRow<const T> Row(unsigned int y) const;
+    T *begin();
+    T *end();
+    const T *begin() const;
+    const T *end() const;
+
     // Basic Manipulation
     T &Get();
     T* GetHead() { return data_;}
@@ -792,12 +960,112 @@ namespace RConsole
     void SetIndex(unsigned int index);
 
   private:
+    // Storage is aligned for vector loads.
+    static const size_t Alignment = 64;
+
+    // Private methods
+    void allocate(unsigned int count);
+    void release();
+    void copy(const Field2D &rhs);
+    static void clear(T *cells, unsigned int count);
+    static void shift(T *to, T *from, unsigned int count);
+
     // Variables
     unsigned int index_;
     unsigned int width_;
     unsigned int height_;
+    unsigned int capacity_;
+    void *block_;
     T *data_;
   };
+
+
+  // A 2D field split into square tiles that are only allocated once written to, for areas
+  // far larger than the screen that are mostly empty, like big scrollable maps. Reading
+  // where nothing was written gives the empty value. Only the tile table is proportional to
+  // the whole area, at a pointer per tile.
+  template <typename T, unsigned int TileSize = 32>
+  class TiledField2D
+  {
+  public:
+    // Cells along each side of a tile.
+    static const unsigned int Size = TileSize;
+
+    // Constructor
+    TiledField2D(unsigned int w, unsigned int h, const T emptyVal = T());
+    ~TiledField2D();
+
+    // Structure Info
+    unsigned int Width() const;
+    unsigned int Height() const;
+    unsigned int TilesX() const;
+    unsigned int TilesY() const;
+    size_t GetTileCount() const;
+
+    // Member Functions
+    T &Get(unsigned int x, unsigned int y);
+    void Set(unsigned int x, unsigned int y, const T &newItem);
+    const T &Peek(unsigned int x, unsigned int y) const;
+    const T *GetTile(unsigned int tileX, unsigned int tileY) const;
+    const T &GetEmpty() const;
+    void Clear();
+    void Blit(Field2D<T> &dest, unsigned int viewX, unsigned int viewY) const;
+
+  private:
+    // No copying, tiles are owned.
+    TiledField2D(const TiledField2D &rhs) = delete;
+    TiledField2D &operator=(const TiledField2D &rhs) = delete;
+
+    // Private methods
+    T *tile(unsigned int x, unsigned int y);
+
+    // Variables
+    unsigned int width_;
+    unsigned int height_;
+    unsigned int tilesX_;
+    unsigned int tilesY_;
+    size_t tileCount_;
+    T empty_;
+    std::vector<T *> tiles_;
+  };
+
+
+  // A 2D field of flags packed 64 to a word. Spans are set and reset a word at a time, and
+  // finding the next set or unset flag skips whole words, so scanning a mostly clear or
+  // mostly full mask costs a 64th of looking at every cell.
+  class DirtyMask
+  {
+  public:
+    // Constructor
+    DirtyMask(unsigned int w, unsigned int h);
+
+    // Structure Info
+    unsigned int Width() const;
+    unsigned int Height() const;
+    unsigned int Length() const;
+    void Resize(unsigned int w, unsigned int h);
+
+    // Member Functions
+    bool Test(unsigned int index) const;
+    void Set(unsigned int index);
+    void Reset(unsigned int index);
+    void SetRange(unsigned int begin, unsigned int end);
+    void ResetRange(unsigned int begin, unsigned int end);
+    void Fill();
+    void Zero();
+    unsigned int NextSet(unsigned int from) const;
+    unsigned int NextUnset(unsigned int from) const;
+
+  private:
+    // Private methods
+    static unsigned int countTrailingZeros(uint64_t word);
+    unsigned int next(unsigned int from, uint64_t flip) const;
+
+    // Variables
+    unsigned int width_;
+    unsigned int height_;
+    std::vector<uint64_t> words_;
+  };
 }
 
 
@@ -815,12 +1083,53 @@ namespace RConsole
 
 
   // [] Operator Overload.
-  // Note- This sets the current index!
   template <typename T>
   inline T &Field2DProxy<T>::operator[](unsigned int y)
   {
-    field_->GoTo(x_, y);
-    return field_->Get();
+    return field_->data_[x_ + y * field_->width_];
+  }
+
+
+    ////////////////////////
+   // Field2DRow Methods //
+  ////////////////////////
+  // Constructor
+  template <typename T>
+  inline Field2DRow<T>::Field2DRow(T *cells, unsigned int width)
+    : cells_(cells)
+    , width_(width)
+  {  }
+
+
+  // First cell of the row.
+  template <typename T>
+  inline T *Field2DRow<T>::begin() const
+  {
+    return cells_;
+  }
+
+
+  // One past the last cell of the row.
+  template <typename T>
+  inline T *Field2DRow<T>::end() const
+  {
+    return cells_ + width_;
+  }
+
+
+  // Cells in the row.
+  template <typename T>
+  inline unsigned int Field2DRow<T>::Size() const
+  {
+    return width_;
+  }
+
+
+  // The cell X along the row.
+  template <typename T>
+  inline T &Field2DRow<T>::operator[](unsigned int x) const
+  {
+    return cells_[x];
   }
 
     ////////////////////
@@ -857,8 +1166,11 @@ namespace RConsole
     : index_(0)
     , width_(w)
     , height_(h)
+    , capacity_(0)
+    , block_(nullptr)
+    , data_(nullptr)
   {
-    data_ = new T[w * h];
+    allocate(w * h);
     Zero();
   };
 
@@ -869,51 +1181,78 @@ namespace RConsole
     : index_(0)
     , width_(w)
     , height_(h)
+    , capacity_(0)
+    , block_(nullptr)
     , data_(nullptr)
   {
-    T* adsf = new T[w * h];
-    data_ = adsf;
-    for (unsigned int i = 0; i < w; ++i)
-      for (unsigned int j = 0; j < h; ++j)
-      {
-        Set(defaultVal);
-        IncrementX();
-      }
-    index_ = 0;
+    allocate(w * h);
+    Fill(defaultVal);
   }
 
 
+  // Copy constructor
   template <typename T>
   inline Field2D<T>::Field2D(const Field2D<T> &rhs)
+    : index_(0)
+    , width_(0)
+    , height_(0)
+    , capacity_(0)
+    , block_(nullptr)
+    , data_(nullptr)
   {
-    if (data_)
-      delete[] data_;
+    copy(rhs);
+  }
 
-    data_ = new T[rhs.width_ * rhs.height_];
-    width_ = rhs.width_;
-    height_ = rhs.height_;
-    index_ = rhs.index_;
 
-    for (unsigned int i = 0; i < width_ * height_; ++i)
-      data_[i] = rhs.data_[i];
+  // Move constructor, takes the buffer and leaves an empty field behind.
+  template <typename T>
+  inline Field2D<T>::Field2D(Field2D<T> &&rhs)
+    : index_(rhs.index_)
+    , width_(rhs.width_)
+    , height_(rhs.height_)
+    , capacity_(rhs.capacity_)
+    , block_(rhs.block_)
+    , data_(rhs.data_)
+  {
+    rhs.index_ = 0;
+    rhs.width_ = 0;
+    rhs.height_ = 0;
+    rhs.capacity_ = 0;
+    rhs.block_ = nullptr;
+    rhs.data_ = nullptr;
   }
 
-  // Assignment operator
+
+  // Assignment operator, reuses the buffer if it is big enough.
   template <typename T>
   inline Field2D<T> & Field2D<T>::operator=(const Field2D<T> &rhs)
+  {
+    if (&rhs != this)
+      copy(rhs);
+    return *this;
+  }
+
+
+  // Move assignment operator
+  template <typename T>
+  inline Field2D<T> & Field2D<T>::operator=(Field2D<T> &&rhs)
   {
     if (&rhs != this)
     {
-      if (data_)
-        delete[] data_;
-      
-      data_ = new T[rhs.width_ * rhs.height_];
+      release();
+      index_ = rhs.index_;
       width_ = rhs.width_;
       height_ = rhs.height_;
-      index_ = rhs.index_;
-
-      for (unsigned int i = 0; i < width_ * height_; ++i)
-        data_[i] = rhs.data_[i];
+      capacity_ = rhs.capacity_;
+      block_ = rhs.block_;
+      data_ = rhs.data_;
+
+      rhs.index_ = 0;
+      rhs.width_ = 0;
+      rhs.height_ = 0;
+      rhs.capacity_ = 0;
+      rhs.block_ = nullptr;
+      rhs.data_ = nullptr;
     }
     return *this;
   }
@@ -923,7 +1262,156 @@ namespace RConsole
   template <typename T>
   inline Field2D<T>::~Field2D()
   {
-    delete[] data_;
+    release();
+  }
+
+
+  // Gets how many cells fit in the buffer without reallocating.
+  template <typename T>
+  inline unsigned int Field2D<T>::Capacity() const
+  {
+    return capacity_;
+  }
+
+
+  // Changes the size of the field and zeroes it, like a new one. The buffer is only
+  // reallocated when it is too small, so resizing back and forth doesn't touch the heap.
+  template <typename T>
+  inline void Field2D<T>::Resize(unsigned int w, unsigned int h)
+  {
+    if (w * h > capacity_)
+    {
+      release();
+      allocate(w * h);
+    }
+    width_ = w;
+    height_ = h;
+    index_ = 0;
+    Zero();
+  }
+
+
+  // Changes the size of the field, keeping the cells in the area both sizes share where
+  // they were by X and Y, and zeroing the rest. Rows are moved within the buffer when it is
+  // big enough, so only growing past the capacity touches the heap.
+  template <typename T>
+  inline void Field2D<T>::Reshape(unsigned int w, unsigned int h)
+  {
+    const unsigned int keepW = std::min(w, width_);
+    const unsigned int keepH = std::min(h, height_);
+    if (w * h > capacity_)
+    {
+      Field2D<T> grown(w, h);
+      for (unsigned int y = 0; y < keepH; ++y)
+        shift(grown.data_ + y * w, data_ + y * width_, keepW);
+      *this = std::move(grown);
+      return;
+    }
+
+    // Narrower rows move towards the front, so go front to back, and wider ones the
+    // other way around.
+    if (w <= width_)
+    {
+      for (unsigned int y = 0; y < keepH; ++y)
+        shift(data_ + y * w, data_ + y * width_, keepW);
+    }
+    else
+    {
+      for (unsigned int y = keepH; y-- > 0;)
+      {
+        shift(data_ + y * w, data_ + y * width_, keepW);
+        clear(data_ + y * w + keepW, w - keepW);
+      }
+    }
+
+    clear(data_ + keepH * w, w * h - keepH * w);
+    width_ = w;
+    height_ = h;
+    index_ = 0;
+  }
+
+
+  // Gets an aligned buffer for count cells, all default constructed.
+  template <typename T>
+  inline void Field2D<T>::allocate(unsigned int count)
+  {
+    static_assert(alignof(T) <= Alignment, "Field2D can't align this type.");
+
+    capacity_ = count;
+    if (count == 0)
+      return;
+
+    block_ = ::operator new(sizeof(T) * count + Alignment - 1);
+    const uintptr_t address = reinterpret_cast<uintptr_t>(block_);
+    data_ = reinterpret_cast<T *>((address + Alignment - 1) & ~static_cast<uintptr_t>(Alignment - 1));
+    for (unsigned int i = 0; i < count; ++i)
+      new (data_ + i) T();
+  }
+
+
+  // Destroys every cell and gives the buffer back.
+  template <typename T>
+  inline void Field2D<T>::release()
+  {
+    if (!std::is_trivially_destructible<T>::value)
+      for (unsigned int i = 0; i < capacity_; ++i)
+        data_[i].~T();
+
+    ::operator delete(block_);
+    block_ = nullptr;
+    data_ = nullptr;
+    capacity_ = 0;
+  }
+
+
+  // Takes on the size and contents of another field, in bulk where the type allows it.
+  template <typename T>
+  inline void Field2D<T>::copy(const Field2D<T> &rhs)
+  {
+    const unsigned int length = rhs.width_ * rhs.height_;
+    if (length > capacity_)
+    {
+      release();
+      allocate(length);
+    }
+    width_ = rhs.width_;
+    height_ = rhs.height_;
+    index_ = rhs.index_;
+
+    if (length == 0)
+      return;
+    if (std::is_trivially_copyable<T>::value)
+      memcpy(static_cast<void *>(data_), rhs.data_, sizeof(T) * length);
+    else
+      std::copy(rhs.data_, rhs.data_ + length, data_);
+  }
+
+
+  // Sets cells back to zero, in bulk where the type allows it, otherwise to new ones.
+  template <typename T>
+  inline void Field2D<T>::clear(T *cells, unsigned int count)
+  {
+    if (count == 0)
+      return;
+    if (std::is_trivially_copyable<T>::value)
+      memset(static_cast<void *>(cells), 0, sizeof(T) * count);
+    else
+      std::fill(cells, cells + count, T());
+  }
+
+
+  // Moves count cells, which may overlap where they land, in bulk where the type allows it.
+  template <typename T>
+  inline void Field2D<T>::shift(T *to, T *from, unsigned int count)
+  {
+    if (count == 0 || to == from)
+      return;
+    if (std::is_trivially_copyable<T>::value)
+      memmove(static_cast<void *>(to), from, sizeof(T) * count);
+    else if (to < from)
+      std::move(from, from + count, to);
+    else
+      std::move_backward(from, from + count, to + count);
   }
 
 
@@ -935,8 +1423,7 @@ namespace RConsole
   template <typename T>
   inline T &Field2D<T>::Get(unsigned int x, unsigned int y)
   {
-    GoTo(x, y);
-    return Get();
+    return data_[x + y * width_];
   }
 
 
@@ -944,7 +1431,7 @@ namespace RConsole
   template <typename T>
   inline const T &Field2D<T>::Get(unsigned int x, unsigned int y) const
   {
-    return Get(x, y);
+    return data_[x + y * width_];
   }
 
 
@@ -992,7 +1479,7 @@ namespace RConsole
   template <typename T>
   inline void Field2D<T>::Zero()
   {
-    memset(data_, 0, sizeof(T) * width_ * height_);
+    clear(data_, width_ * height_);
   }
 
 
@@ -1009,618 +1496,3397 @@ namespace RConsole
   template <typename T>
   inline void Field2D<T>::Fill(const T &objToUse, unsigned int startIndex, unsigned int endIndex)
   {
-    unsigned int prevIndex = index_;
-    index_ = startIndex;
-    for (unsigned int i = startIndex; i < endIndex; ++i)
-    {
-      Set(objToUse);
-      IncrementX();
-    }
-    index_ = prevIndex;
+    std::fill(data_ + startIndex, data_ + endIndex, objToUse);
   }
 
-    //////////////////////
-   // Cheap operations //
-  //////////////////////
-  // Get the value at the current index.
+
+  // Gets the index of a location in memory, without going there.
   template <typename T>
-  inline T &Field2D<T>::Get()
+  inline unsigned int Field2D<T>::IndexOf(unsigned int x, unsigned int y) const
   {
-    return data_[index_];
+    return x + y * width_;
   }
 
 
-  // Const get.
+  // Gets a view of row Y.
   template <typename T>
-  inline const T& Field2D<T>::Get() const
+  inline Field2DRow<T> Field2D<T>::Row(unsigned int y)
   {
-    return data_[index_];
+    return Field2DRow<T>(data_ + y * width_, width_);
   }
 
 
-  // Increment X location by 1 in the 2D field
+  // Gets a read-only view of row Y.
   template <typename T>
-  inline void Field2D<T>::IncrementX()
+  inline Field2DRow<const T> Field2D<T>::Row(unsigned int y) const
   {
-    ++index_;
+    return Field2DRow<const T>(data_ + y * width_, width_);
   }
 
 
-  // Increment Y location by 1 in the 2D field
+  // First cell, for walking the whole field in memory order.
   template <typename T>
-  inline void Field2D<T>::IncrementY()
+  inline T *Field2D<T>::begin()
   {
-    index_ += width_;
+    return data_;
   }
 
 
-  // Decrement X location by 1 in the 2D field
+  // One past the last cell.
   template <typename T>
-  inline void Field2D<T>::DecrementX()
+  inline T *Field2D<T>::end()
   {
-    --index_;
+    return data_ + width_ * height_;
   }
 
 
-  // Decrement Y location by 1 in the 2D Field
+  // First cell, read-only.
   template <typename T>
-  inline void Field2D<T>::DecrementY()
+  inline const T *Field2D<T>::begin() const
   {
-    index_ -= width_;
+    return data_;
   }
 
 
-  // Gets the index that the 2D Field currently has.
+  // One past the last cell, read-only.
   template <typename T>
-  inline unsigned int Field2D<T>::GetIndex()
+  inline const T *Field2D<T>::end() const
   {
-    return index_;
+    return data_ + width_ * height_;
   }
 
-
-  // Gets the index that the 2D Field currently has.
-  template <typename T>
-  inline void Field2D<T>::SetIndex(unsigned int index)
-  {
+    //////////////////////
+   // Cheap operations //
+  //////////////////////
+  // Get the value at the current index.
+  template <typename T>
+  inline T &Field2D<T>::Get()
+  {
+    return data_[index_];
+  }
+
+
+  // Const get.
+  template <typename T>
+  inline const T& Field2D<T>::Get() const
+  {
+    return data_[index_];
+  }
+
+
+  // Increment X location by 1 in the 2D field
+  template <typename T>
+  inline void Field2D<T>::IncrementX()
+  {
+    ++index_;
+  }
+
+
+  // Increment Y location by 1 in the 2D field
+  template <typename T>
+  inline void Field2D<T>::IncrementY()
+  {
+    index_ += width_;
+  }
+
+
+  // Decrement X location by 1 in the 2D field
+  template <typename T>
+  inline void Field2D<T>::DecrementX()
+  {
+    --index_;
+  }
+
+
+  // Decrement Y location by 1 in the 2D Field
+  template <typename T>
+  inline void Field2D<T>::DecrementY()
+  {
+    index_ -= width_;
+  }
+
+
+  // Gets the index that the 2D Field currently has.
+  template <typename T>
+  inline unsigned int Field2D<T>::GetIndex()
+  {
+    return index_;
+  }
+
+
+  // Gets the index that the 2D Field currently has.
+  template <typename T>
+  inline void Field2D<T>::SetIndex(unsigned int index)
+  {
     index_ = index;
   }
-}
 
-///////////////////////////////////////////////////////////////////////
-//CanvasRaster.hpp
-///////////////////////////////////////////////////////////////////////
 
+    //////////////////////////////////
+   // TiledField2D Methods and Co. //
+  //////////////////////////////////
+  // Constructor, no tiles are allocated until written to.
+  template <typename T, unsigned int TileSize>
+  inline TiledField2D<T, TileSize>::TiledField2D(unsigned int w, unsigned int h, const T emptyVal)
+    : width_(w)
+    , height_(h)
+    , tilesX_((w + TileSize - 1) / TileSize)
+    , tilesY_((h + TileSize - 1) / TileSize)
+    , tileCount_(0)
+    , empty_(emptyVal)
+    , tiles_(static_cast<size_t>(tilesX_) * tilesY_, nullptr)
+  {  }
 
-namespace RConsole
-{
-  // The raster info struct, holds info on what is to be drawn at a location and the color.
-  struct RasterInfo
+
+  // Destructor
+  template <typename T, unsigned int TileSize>
+  inline TiledField2D<T, TileSize>::~TiledField2D()
   {
-    RasterInfo();
-    RasterInfo(const char val, Color col);
-    bool operator ==(const RasterInfo &rhs) const;
-    bool operator !=(const RasterInfo &rhs) const;
-    char Value;
-    Color C;
-  };
+    Clear();
+  }
 
-  // Console raster class
-  class Canvas;
-  class CanvasRaster
+
+  // Gets the width of the field.
+  template <typename T, unsigned int TileSize>
+  inline unsigned int TiledField2D<T, TileSize>::Width() const
   {
-    friend Canvas;
+    return width_;
+  }
 
-  public:
-    // Constructors
-    CanvasRaster(unsigned int width, unsigned int height);
 
-    // Method Prototypes
-    bool WriteChar(char toDraw, float x, float y, Color color = PREVIOUS_COLOR);
-	  bool WriteString(const char *toWrite, size_t len, float x, float y, Color color = PREVIOUS_COLOR);
-    const Field2D<RasterInfo>& GetRasterData() const;
-    void Fill(const RasterInfo &ri);
-    void Zero();
+  // Gets the height of the field.
+  template <typename T, unsigned int TileSize>
+  inline unsigned int TiledField2D<T, TileSize>::Height() const
+  {
+    return height_;
+  }
 
-    // General
-    unsigned int GetRasterWidth() const;
-    unsigned int GetRasterHeight() const;
 
-  private:
-    // Private member functions
-    Field2D<RasterInfo>& GetRasterData();
+  // Gets how many tiles across the field is.
+  template <typename T, unsigned int TileSize>
+  inline unsigned int TiledField2D<T, TileSize>::TilesX() const
+  {
+    return tilesX_;
+  }
 
-    // Variables
-    unsigned int width_;
-    unsigned int height_;
-    Field2D<RasterInfo> data_;
 
-  };
-}
+  // Gets how many tiles down the field is.
+  template <typename T, unsigned int TileSize>
+  inline unsigned int TiledField2D<T, TileSize>::TilesY() const
+  {
+    return tilesY_;
+  }
 
 
-///////////////////////////////////////////////////////////////////////
-//Canvas.hpp
-///////////////////////////////////////////////////////////////////////
+  // Gets how many tiles are allocated.
+  template <typename T, unsigned int TileSize>
+  inline size_t TiledField2D<T, TileSize>::GetTileCount() const
+  {
+    return tileCount_;
+  }
 
 
-namespace RConsole
-{
-  class Canvas
+  // Get the item at the position X, Y, allocating its tile if needed.
+  template <typename T, unsigned int TileSize>
+  inline T &TiledField2D<T, TileSize>::Get(unsigned int x, unsigned int y)
   {
-  public:
-    // Init call
-    static void ReInit(unsigned int width, unsigned int height);
+    return tile(x, y)[(y % TileSize) * TileSize + (x % TileSize)];
+  }
 
-    // Basic drawing calls
-    static bool Update();
-    static void FillCanvas(const RasterInfo &ri = RasterInfo(' ', WHITE));
-    static void Draw(char toWrite, float x, float y, Color color = PREVIOUS_COLOR);
-	  static void DrawString(const char* toDraw, float xStart, float yStart, Color color = PREVIOUS_COLOR);
-    static void DrawAlpha(float x, float y, Color color, float opacity);
-    static void Shutdown();
 
-    // Advanced drawing calls
-    static void DrawPartialPoint(float x, float y, Color color);
-    static void DrawBox(char toWrite, float x1, float y1, float x2, float y2, Color color);
-    static void SetCursorVisible(bool isVisible);
-    static void DumpRaster(FILE *fp = stdout);
-    static void CropRaster(FILE *fp = stdout, char toTrim = ' ');
+  // Sets the item at the position X, Y, allocating its tile if needed.
+  template <typename T, unsigned int TileSize>
+  inline void TiledField2D<T, TileSize>::Set(unsigned int x, unsigned int y, const T &newItem)
+  {
+    Get(x, y) = newItem;
+  }
 
-    // Data related calls
-    static unsigned int GetConsoleWidht();
-    static unsigned int GetConsoleHeight();
-  private:
-    // Hidden Constructors- no instantiating publicly!
-    Canvas() { };
-    Canvas(const Canvas &rhs) { *this = rhs; }
-    
-    // Private methods.
-    static void clearPrevious();
-    static void fullClear();
-    static void setColor(const Color &color);
-    static bool writeRaster(CanvasRaster &r);
-    static int  putC(int character, FILE * stream );
-    static void setCloseHandler();
 
-    // Any rasters we have. Could be expanded to have two, so you could "swap" them,
-    // Although practicality of that is limited given the clearing technique.
-    static CanvasRaster r_;
-    static CanvasRaster prev_;
+  // Glance at a read-only version of a specified location, the empty value if its tile
+  // was never written to.
+  template <typename T, unsigned int TileSize>
+  inline const T &TiledField2D<T, TileSize>::Peek(unsigned int x, unsigned int y) const
+  {
+    const T *t = tiles_[(y / TileSize) * tilesX_ + (x / TileSize)];
+    if (t == nullptr)
+      return empty_;
+    return t[(y % TileSize) * TileSize + (x % TileSize)];
+  }
 
-    // The tabs on what was last modified. This is important, because we will only update
-    // what we care about.
-    static bool hasLazyInit_;
-    static bool isDrawing_;
-    static unsigned int width_;
-    static unsigned int height_;
-    static Field2D<bool> modified_;
-  };
-}
 
-///////////////////////////////////////////////////////////////////////
-//CanvasRaster.cpp
-///////////////////////////////////////////////////////////////////////
+  // Gets a tile's cells, row by row, or null if it was never written to.
+  template <typename T, unsigned int TileSize>
+  inline const T *TiledField2D<T, TileSize>::GetTile(unsigned int tileX, unsigned int tileY) const
+  {
+    return tiles_[tileY * tilesX_ + tileX];
+  }
 
 
+  // Gets what unwritten cells hold.
+  template <typename T, unsigned int TileSize>
+  inline const T &TiledField2D<T, TileSize>::GetEmpty() const
+  {
+    return empty_;
+  }
 
-namespace RConsole
-{
-   /////////////////////////
-   // Raster info object //
-  ////////////////////////
-  // 
-  //constructor, no character and just the previous color.
-  inline RasterInfo::RasterInfo() : Value(0), C(Color::PREVIOUS_COLOR)
-  {  }
 
-  
-  // Non-Default constructor, specifies const character and color.
-  inline RasterInfo::RasterInfo(const char val, Color col) : Value(val), C(col)
-  {  }
+  // Frees every tile.
+  template <typename T, unsigned int TileSize>
+  inline void TiledField2D<T, TileSize>::Clear()
+  {
+    for (T *&t : tiles_)
+    {
+      delete[] t;
+      t = nullptr;
+    }
+    tileCount_ = 0;
+  }
 
 
-  // Overloaded comparision operator that checks all fields.
-  inline bool RasterInfo::operator ==(const RasterInfo &rhs) const
+  // Copies the area of the field starting at viewX, viewY into a dense field, filling it.
+  // Cells past the edges of the field are empty. Unallocated tiles are filled without being
+  // looked into, so the cost follows the visible tiles and not the size of the field.
+  template <typename T, unsigned int TileSize>
+  inline void TiledField2D<T, TileSize>::Blit(Field2D<T> &dest, unsigned int viewX, unsigned int viewY) const
   {
-    if (rhs.C == C && rhs.Value == Value)
-      return true;
-    return false;
+    const unsigned int destW = dest.Width();
+    const unsigned int destH = dest.Height();
+    T *out = dest.GetHead();
+    for (unsigned int row = 0; row < destH; ++row)
+    {
+      const unsigned int y = viewY + row;
+      T *line = out + row * destW;
+      if (y >= height_)
+      {
+        std::fill(line, line + destW, empty_);
+        continue;
+      }
+
+      // Walk the row a tile span at a time.
+      unsigned int col = 0;
+      while (col < destW)
+      {
+        const unsigned int x = viewX + col;
+        if (x >= width_)
+        {
+          std::fill(line + col, line + destW, empty_);
+          break;
+        }
+
+        const unsigned int span = std::min(TileSize - x % TileSize, std::min(destW - col, width_ - x));
+        const T *t = tiles_[(y / TileSize) * tilesX_ + (x / TileSize)];
+        if (t == nullptr)
+          std::fill(line + col, line + col + span, empty_);
+        else
+        {
+          const T *src = t + (y % TileSize) * TileSize + (x % TileSize);
+          std::copy(src, src + span, line + col);
+        }
+        col += span;
+      }
+    }
   }
 
 
-  // Overloaded comparison operator that checks all fields.
-  inline bool RasterInfo::operator !=(const RasterInfo &rhs) const
+  // Gets the tile holding a location, allocating it filled with the empty value.
+  template <typename T, unsigned int TileSize>
+  inline T *TiledField2D<T, TileSize>::tile(unsigned int x, unsigned int y)
   {
-    return !(*this == rhs);
+    T *&t = tiles_[(y / TileSize) * tilesX_ + (x / TileSize)];
+    if (t == nullptr)
+    {
+      t = new T[TileSize * TileSize];
+      std::fill(t, t + TileSize * TileSize, empty_);
+      ++tileCount_;
+    }
+    return t;
   }
 
 
-    ///////////////////////////
-   // Console Raster object //
-  ///////////////////////////
-  // Default constructor for the CanvasRaster- Zeros data and gets width and height.
-  inline CanvasRaster::CanvasRaster(unsigned int width, unsigned int height)
-    : width_(width)
-    , height_(height)
-    , data_(width, height, RasterInfo(' ', RConsole::WHITE))
+    ///////////////////////////////
+   // DirtyMask Methods and Co. //
+  ///////////////////////////////
+  // Constructor, everything starts out clear.
+  inline DirtyMask::DirtyMask(unsigned int w, unsigned int h)
+    : width_(w)
+    , height_(h)
+    , words_((static_cast<size_t>(w) * h + 63) / 64, 0)
   {  }
 
 
-  // Draws a character to the screen. Returns if it was successful or not.
-  inline bool CanvasRaster::WriteChar(char toDraw, float x, float y, Color color)
+  // Gets the width of the mask.
+  inline unsigned int DirtyMask::Width() const
   {
-    #ifdef RConsole_CLIP_CONSOLE
+    return width_;
+  }
 
-    if (x > width_) return false;
-    if (y > height_) return false;
 
-    #endif // RConsole_CLIP_CONSOLE
+  // Gets the height of the mask.
+  inline unsigned int DirtyMask::Height() const
+  {
+    return height_;
+  }
 
-    data_.GoTo(static_cast<int>(x), static_cast<int>(y));
-    data_.Set(RasterInfo(toDraw, color));
-  
-    //Everything completed correctly.
-    return true;
+
+  // Gets how many flags there are.
+  inline unsigned int DirtyMask::Length() const
+  {
+    return width_ * height_;
   }
 
 
-  // Writes a string to the field
-  inline bool CanvasRaster::WriteString(const char *toWrite, size_t len, float x, float y, Color color)
+  // Changes the size and clears everything, keeping the words already allocated.
+  inline void DirtyMask::Resize(unsigned int w, unsigned int h)
   {
-	  //Establish and check for a string of a usable size.
-	  data_.GoTo(static_cast<int>(x), static_cast<int>(y));
-	  for (unsigned int i = 0; i < len; ++i)
-	  {
-		  data_.Set(RasterInfo(toWrite[i], color));
-		  data_.IncrementX();
-	  }
+    width_ = w;
+    height_ = h;
+    words_.assign((static_cast<size_t>(w) * h + 63) / 64, 0);
+  }
+
 
-	  //Return success.
-	  return true;
+  // Checks a single flag.
+  inline bool DirtyMask::Test(unsigned int index) const
+  {
+    return (words_[index / 64] >> (index % 64)) & 1;
   }
 
 
-  // Writes a mass of spaces to the screen.
-  inline void CanvasRaster::Fill(const RasterInfo &ri)
+  // Sets a single flag.
+  inline void DirtyMask::Set(unsigned int index)
   {
-    data_.Fill(ri);
+    words_[index / 64] |= uint64_t(1) << (index % 64);
   }
-  
 
-  // Clears out all of the data written to the raster. Does NOT move cursor to 0,0.
-  inline void CanvasRaster::Zero()
+
+  // Clears a single flag.
+  inline void DirtyMask::Reset(unsigned int index)
   {
-    data_.Zero();
+    words_[index / 64] &= ~(uint64_t(1) << (index % 64));
   }
 
 
-  // Get a constant reference to the existing raster.
-  inline const Field2D<RasterInfo>& CanvasRaster::GetRasterData() const
+  // Sets every flag from begin up to but not including end. Anything past the end of the
+  // mask is ignored.
+  inline void DirtyMask::SetRange(unsigned int begin, unsigned int end)
   {
-    return data_;
+    if (end > Length())
+      end = Length();
+    if (begin >= end)
+      return;
+
+    const unsigned int first = begin / 64;
+    const unsigned int last = (end - 1) / 64;
+    const uint64_t head = ~uint64_t(0) << (begin % 64);
+    const uint64_t tail = ~uint64_t(0) >> (63 - (end - 1) % 64);
+    if (first == last)
+    {
+      words_[first] |= head & tail;
+      return;
+    }
+
+    words_[first] |= head;
+    for (unsigned int word = first + 1; word < last; ++word)
+      words_[word] = ~uint64_t(0);
+    words_[last] |= tail;
   }
 
 
-  // Underlying raster exposing.
-  inline Field2D<RasterInfo>& CanvasRaster::GetRasterData()
+  // Clears every flag from begin up to but not including end.
+  inline void DirtyMask::ResetRange(unsigned int begin, unsigned int end)
   {
-    return data_;
+    if (end > Length())
+      end = Length();
+    if (begin >= end)
+      return;
+
+    const unsigned int first = begin / 64;
+    const unsigned int last = (end - 1) / 64;
+    const uint64_t head = ~uint64_t(0) << (begin % 64);
+    const uint64_t tail = ~uint64_t(0) >> (63 - (end - 1) % 64);
+    if (first == last)
+    {
+      words_[first] &= ~(head & tail);
+      return;
+    }
+
+    words_[first] &= ~head;
+    for (unsigned int word = first + 1; word < last; ++word)
+      words_[word] = 0;
+    words_[last] &= ~tail;
   }
-  
 
-  // Gets console width.
-  inline unsigned int CanvasRaster::GetRasterWidth() const
-  { 
-    return width_;
-  }  
 
+  // Sets every flag.
+  inline void DirtyMask::Fill()
+  {
+    SetRange(0, Length());
+  }
+
+
+  // Clears every flag.
+  inline void DirtyMask::Zero()
+  {
+    std::fill(words_.begin(), words_.end(), 0);
+  }
+
+
+  // Finds the first set flag at or after from, or Length() if there are none.
+  inline unsigned int DirtyMask::NextSet(unsigned int from) const
+  {
+    return next(from, 0);
+  }
+
+
+  // Finds the first clear flag at or after from, or Length() if there are none.
+  inline unsigned int DirtyMask::NextUnset(unsigned int from) const
+  {
+    return next(from, ~uint64_t(0));
+  }
+
+
+  // Index of the lowest set bit of a word that isn't zero.
+  inline unsigned int DirtyMask::countTrailingZeros(uint64_t word)
+  {
+    #ifdef COMPILER_VS
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return static_cast<unsigned int>(index);
+    #else
+    return static_cast<unsigned int>(__builtin_ctzll(word));
+    #endif
+  }
+
+
+  // Finds the first flag at or after from that is set once flipped, a word at a time.
+  inline unsigned int DirtyMask::next(unsigned int from, uint64_t flip) const
+  {
+    const unsigned int length = Length();
+    if (from >= length)
+      return length;
+
+    size_t word = from / 64;
+    uint64_t bits = (words_[word] ^ flip) & (~uint64_t(0) << (from % 64));
+    while (bits == 0)
+    {
+      if (++word >= words_.size())
+        return length;
+      bits = words_[word] ^ flip;
+    }
+
+    // Bits past the end of the mask are always clear, so flipped ones can be found.
+    const unsigned int index = static_cast<unsigned int>(word * 64) + countTrailingZeros(bits);
+    return (index < length) ? index : length;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////
+//Unicode.hpp
+///////////////////////////////////////////////////////////////////////
+#include <array>            // Width table blocks.
+#include <map>              // Sharing identical blocks while building.
+#include <string>           // Encoding into output.
+
+namespace RConsole
+{
+  // UTF-8 and how many columns characters take up on a terminal.
+  namespace Unicode
+  {
+    // Held by the cell to the right of a wide character, which the character covers.
+    const char32_t Continuation = 0x110000;
+
+    // Stands in for bytes that aren't valid UTF-8.
+    const char32_t Replacement = 0xFFFD;
+
+    // Columns a character takes up: 0 for combining marks and the like, 2 for wide ones.
+    int Width(char32_t codePoint);
+
+    // Reads the next character from the bytes at it, stepping past them.
+    char32_t Decode(const char *&it, const char *end);
+
+    // Writes out a character, returning how many of the 4 bytes it took.
+    size_t Encode(char *out, char32_t codePoint);
+    void Encode(std::string &out, char32_t codePoint);
+
+    // Columns a UTF-8 string takes up.
+    size_t TextWidth(const char *text, size_t len);
+
+    // Two level width table. Characters are looked up in blocks of 256, and blocks that
+    // are the same, like most of them, are only stored once, at 2 bits a character.
+    struct WidthTable
+    {
+      WidthTable();
+      uint8_t Index[0x1100];
+      std::vector<uint8_t> Blocks;
+    };
+    const WidthTable &widthTable();
+  }
+
+
+    /////////////////////
+   // Unicode Methods //
+  /////////////////////
+  // Builds the table from the ranges of wide and zero width characters.
+  inline Unicode::WidthTable::WidthTable()
+    : Index()
+    , Blocks()
+  {
+    // Wide, from the East Asian Wide and Fullwidth properties and wide emoji.
+    static const char32_t wide[][2] = {
+      { 0x1100, 0x115F }, { 0x231A, 0x231B }, { 0x2329, 0x232A }, { 0x23E9, 0x23EC }, { 0x23F0, 0x23F0 },
+      { 0x23F3, 0x23F3 }, { 0x25FD, 0x25FE }, { 0x2614, 0x2615 }, { 0x2648, 0x2653 }, { 0x267F, 0x267F },
+      { 0x2693, 0x2693 }, { 0x26A1, 0x26A1 }, { 0x26AA, 0x26AB }, { 0x26BD, 0x26BE }, { 0x26C4, 0x26C5 },
+      { 0x26CE, 0x26CE }, { 0x26D4, 0x26D4 }, { 0x26EA, 0x26EA }, { 0x26F2, 0x26F3 }, { 0x26F5, 0x26F5 },
+      { 0x26FA, 0x26FA }, { 0x26FD, 0x26FD }, { 0x2705, 0x2705 }, { 0x270A, 0x270B }, { 0x2728, 0x2728 },
+      { 0x274C, 0x274C }, { 0x274E, 0x274E }, { 0x2753, 0x2755 }, { 0x2757, 0x2757 }, { 0x2795, 0x2797 },
+      { 0x27B0, 0x27B0 }, { 0x27BF, 0x27BF }, { 0x2B1B, 0x2B1C }, { 0x2B50, 0x2B50 }, { 0x2B55, 0x2B55 },
+      { 0x2E80, 0x303E }, { 0x3041, 0x33FF }, { 0x3400, 0x4DFF }, { 0x4E00, 0x9FFF }, { 0xA000, 0xA4CF },
+      { 0xA960, 0xA97F }, { 0xAC00, 0xD7A3 }, { 0xF900, 0xFAFF }, { 0xFE10, 0xFE19 }, { 0xFE30, 0xFE6F },
+      { 0xFF00, 0xFF60 }, { 0xFFE0, 0xFFE6 }, { 0x16FE0, 0x16FE4 }, { 0x17000, 0x187F7 }, { 0x18800, 0x18CD5 },
+      { 0x1B000, 0x1B16F }, { 0x1F004, 0x1F004 }, { 0x1F0CF, 0x1F0CF }, { 0x1F18E, 0x1F18E }, { 0x1F191, 0x1F19A },
+      { 0x1F200, 0x1F202 }, { 0x1F210, 0x1F23B }, { 0x1F240, 0x1F248 }, { 0x1F250, 0x1F251 }, { 0x1F260, 0x1F265 },
+      { 0x1F300, 0x1F320 }, { 0x1F32D, 0x1F335 }, { 0x1F337, 0x1F37C }, { 0x1F37E, 0x1F393 }, { 0x1F3A0, 0x1F3CA },
+      { 0x1F3CF, 0x1F3D3 }, { 0x1F3E0, 0x1F3F0 }, { 0x1F3F4, 0x1F3F4 }, { 0x1F3F8, 0x1F43E }, { 0x1F440, 0x1F440 },
+      { 0x1F442, 0x1F4FC }, { 0x1F4FF, 0x1F53D }, { 0x1F54B, 0x1F54E }, { 0x1F550, 0x1F567 }, { 0x1F57A, 0x1F57A },
+      { 0x1F595, 0x1F596 }, { 0x1F5A4, 0x1F5A4 }, { 0x1F5FB, 0x1F64F }, { 0x1F680, 0x1F6C5 }, { 0x1F6CC, 0x1F6CC },
+      { 0x1F6D0, 0x1F6D2 }, { 0x1F6D5, 0x1F6D7 }, { 0x1F6EB, 0x1F6EC }, { 0x1F6F4, 0x1F6FC }, { 0x1F7E0, 0x1F7EB },
+      { 0x1F90C, 0x1F93A }, { 0x1F93C, 0x1F945 }, { 0x1F947, 0x1F9FF }, { 0x1FA70, 0x1FAFF }, { 0x20000, 0x2FFFD },
+      { 0x30000, 0x3FFFD }
+    };
+
+    // Zero width, combining marks, joiners and other invisible format characters.
+    static const char32_t zero[][2] = {
+      { 0x0300, 0x036F }, { 0x0483, 0x0489 }, { 0x0591, 0x05BD }, { 0x05BF, 0x05BF }, { 0x05C1, 0x05C2 },
+      { 0x05C4, 0x05C5 }, { 0x05C7, 0x05C7 }, { 0x0610, 0x061A }, { 0x061C, 0x061C }, { 0x064B, 0x065F },
+      { 0x0670, 0x0670 }, { 0x06D6, 0x06DC }, { 0x06DF, 0x06E4 }, { 0x06E7, 0x06E8 }, { 0x06EA, 0x06ED },
+      { 0x0711, 0x0711 }, { 0x0730, 0x074A }, { 0x07A6, 0x07B0 }, { 0x07EB, 0x07F3 }, { 0x07FD, 0x07FD },
+      { 0x0816, 0x0819 }, { 0x081B, 0x0823 }, { 0x0825, 0x0827 }, { 0x0829, 0x082D }, { 0x0859, 0x085B },
+      { 0x0898, 0x089F }, { 0x08CA, 0x08E1 }, { 0x08E3, 0x0902 }, { 0x093A, 0x093A }, { 0x093C, 0x093C },
+      { 0x0941, 0x0948 }, { 0x094D, 0x094D }, { 0x0951, 0x0957 }, { 0x0962, 0x0963 }, { 0x0981, 0x0981 },
+      { 0x09BC, 0x09BC }, { 0x09C1, 0x09C4 }, { 0x09CD, 0x09CD }, { 0x09E2, 0x09E3 }, { 0x09FE, 0x09FE },
+      { 0x0A01, 0x0A02 }, { 0x0A3C, 0x0A3C }, { 0x0A41, 0x0A42 }, { 0x0A47, 0x0A48 }, { 0x0A4B, 0x0A4D },
+      { 0x0A51, 0x0A51 }, { 0x0A70, 0x0A71 }, { 0x0A75, 0x0A75 }, { 0x0A81, 0x0A82 }, { 0x0ABC, 0x0ABC },
+      { 0x0AC1, 0x0AC5 }, { 0x0AC7, 0x0AC8 }, { 0x0ACD, 0x0ACD }, { 0x0AE2, 0x0AE3 }, { 0x0AFA, 0x0AFF },
+      { 0x0B01, 0x0B01 }, { 0x0B3C, 0x0B3C }, { 0x0B3F, 0x0B3F }, { 0x0B41, 0x0B44 }, { 0x0B4D, 0x0B4D },
+      { 0x0B55, 0x0B56 }, { 0x0B62, 0x0B63 }, { 0x0B82, 0x0B82 }, { 0x0BC0, 0x0BC0 }, { 0x0BCD, 0x0BCD },
+      { 0x0C00, 0x0C00 }, { 0x0C04, 0x0C04 }, { 0x0C3C, 0x0C3C }, { 0x0C3E, 0x0C40 }, { 0x0C46, 0x0C48 },
+      { 0x0C4A, 0x0C4D }, { 0x0C55, 0x0C56 }, { 0x0C62, 0x0C63 }, { 0x0C81, 0x0C81 }, { 0x0CBC, 0x0CBC },
+      { 0x0CBF, 0x0CBF }, { 0x0CC6, 0x0CC6 }, { 0x0CCC, 0x0CCD }, { 0x0CE2, 0x0CE3 }, { 0x0D00, 0x0D01 },
+      { 0x0D3B, 0x0D3C }, { 0x0D41, 0x0D44 }, { 0x0D4D, 0x0D4D }, { 0x0D62, 0x0D63 }, { 0x0D81, 0x0D81 },
+      { 0x0DCA, 0x0DCA }, { 0x0DD2, 0x0DD4 }, { 0x0DD6, 0x0DD6 }, { 0x0E31, 0x0E31 }, { 0x0E34, 0x0E3A },
+      { 0x0E47, 0x0E4E }, { 0x0EB1, 0x0EB1 }, { 0x0EB4, 0x0EBC }, { 0x0EC8, 0x0ECD }, { 0x0F18, 0x0F19 },
+      { 0x0F35, 0x0F35 }, { 0x0F37, 0x0F37 }, { 0x0F39, 0x0F39 }, { 0x0F71, 0x0F7E }, { 0x0F80, 0x0F84 },
+      { 0x0F86, 0x0F87 }, { 0x0F8D, 0x0FBC }, { 0x0FC6, 0x0FC6 }, { 0x102D, 0x1030 }, { 0x1032, 0x1037 },
+      { 0x1039, 0x103A }, { 0x103D, 0x103E }, { 0x1058, 0x1059 }, { 0x105E, 0x1060 }, { 0x1071, 0x1074 },
+      { 0x1082, 0x1082 }, { 0x1085, 0x1086 }, { 0x108D, 0x108D }, { 0x109D, 0x109D }, { 0x1160, 0x11FF },
+      { 0x135D, 0x135F }, { 0x1712, 0x1714 }, { 0x1732, 0x1733 }, { 0x1752, 0x1753 }, { 0x1772, 0x1773 },
+      { 0x17B4, 0x17B5 }, { 0x17B7, 0x17BD }, { 0x17C6, 0x17C6 }, { 0x17C9, 0x17D3 }, { 0x17DD, 0x17DD },
+      { 0x180B, 0x180F }, { 0x1885, 0x1886 }, { 0x18A9, 0x18A9 }, { 0x1920, 0x1922 }, { 0x1927, 0x1928 },
+      { 0x1932, 0x1932 }, { 0x1939, 0x193B }, { 0x1A17, 0x1A18 }, { 0x1A1B, 0x1A1B }, { 0x1A56, 0x1A56 },
+      { 0x1A58, 0x1A5E }, { 0x1A60, 0x1A60 }, { 0x1A62, 0x1A62 }, { 0x1A65, 0x1A6C }, { 0x1A73, 0x1A7C },
+      { 0x1A7F, 0x1A7F }, { 0x1AB0, 0x1AFF }, { 0x1B00, 0x1B03 }, { 0x1B34, 0x1B34 }, { 0x1B36, 0x1B3A },
+      { 0x1B3C, 0x1B3C }, { 0x1B42, 0x1B42 }, { 0x1B6B, 0x1B73 }, { 0x1B80, 0x1B81 }, { 0x1BA2, 0x1BA5 },
+      { 0x1BA8, 0x1BA9 }, { 0x1BAB, 0x1BAD }, { 0x1BE6, 0x1BE6 }, { 0x1BE8, 0x1BE9 }, { 0x1BED, 0x1BED },
+      { 0x1BEF, 0x1BF1 }, { 0x1C2C, 0x1C33 }, { 0x1C36, 0x1C37 }, { 0x1CD0, 0x1CD2 }, { 0x1CD4, 0x1CE0 },
+      { 0x1CE2, 0x1CE8 }, { 0x1CED, 0x1CED }, { 0x1CF4, 0x1CF4 }, { 0x1CF8, 0x1CF9 }, { 0x1DC0, 0x1DFF },
+      { 0x200B, 0x200F }, { 0x2028, 0x202E }, { 0x2060, 0x2064 }, { 0x2066, 0x206F }, { 0x20D0, 0x20F0 },
+      { 0x2CEF, 0x2CF1 }, { 0x2D7F, 0x2D7F }, { 0x2DE0, 0x2DFF }, { 0x302A, 0x302D }, { 0x3099, 0x309A },
+      { 0xA66F, 0xA672 }, { 0xA674, 0xA67D }, { 0xA69E, 0xA69F }, { 0xA6F0, 0xA6F1 }, { 0xA802, 0xA802 },
+      { 0xA806, 0xA806 }, { 0xA80B, 0xA80B }, { 0xA825, 0xA826 }, { 0xA82C, 0xA82C }, { 0xA8C4, 0xA8C5 },
+      { 0xA8E0, 0xA8F1 }, { 0xA8FF, 0xA8FF }, { 0xA926, 0xA92D }, { 0xA947, 0xA951 }, { 0xA980, 0xA982 },
+      { 0xA9B3, 0xA9B3 }, { 0xA9B6, 0xA9B9 }, { 0xA9BC, 0xA9BD }, { 0xA9E5, 0xA9E5 }, { 0xAA29, 0xAA2E },
+      { 0xAA31, 0xAA32 }, { 0xAA35, 0xAA36 }, { 0xAA43, 0xAA43 }, { 0xAA4C, 0xAA4C }, { 0xAA7C, 0xAA7C },
+      { 0xAAB0, 0xAAB0 }, { 0xAAB2, 0xAAB4 }, { 0xAAB7, 0xAAB8 }, { 0xAABE, 0xAABF }, { 0xAAC1, 0xAAC1 },
+      { 0xAAEC, 0xAAED }, { 0xAAF6, 0xAAF6 }, { 0xABE5, 0xABE5 }, { 0xABE8, 0xABE8 }, { 0xABED, 0xABED },
+      { 0xD7B0, 0xD7FF }, { 0xFB1E, 0xFB1E }, { 0xFE00, 0xFE0F }, { 0xFE20, 0xFE2F }, { 0xFEFF, 0xFEFF },
+      { 0xFFF9, 0xFFFB }, { 0x101FD, 0x101FD }, { 0x102E0, 0x102E0 }, { 0x10376, 0x1037A }, { 0x10A01, 0x10A0F },
+      { 0x10A38, 0x10A3F }, { 0x11001, 0x11001 }, { 0x11038, 0x11046 }, { 0x1107F, 0x11081 }, { 0x110B3, 0x110B6 },
+      { 0x110B9, 0x110BA }, { 0x11100, 0x11102 }, { 0x11127, 0x1112B }, { 0x1112D, 0x11134 }, { 0x1D167, 0x1D169 },
+      { 0x1D17B, 0x1D182 }, { 0x1D185, 0x1D18B }, { 0x1D1AA, 0x1D1AD }, { 0x1E000, 0x1E02A }, { 0x1E8D0, 0x1E8D6 },
+      { 0x1E944, 0x1E94A }, { 0xE0001, 0xE0001 }, { 0xE0020, 0xE007F }, { 0xE0100, 0xE01EF }
+    };
+
+    // Everything starts out 1 column wide, then the ranges are written over it, zero width
+    // last since a few sit inside wide ranges.
+    std::vector<uint8_t> packed(sizeof(Index) * 64, 0x55);
+    const auto apply = [&packed](const char32_t (*ranges)[2], size_t count, uint8_t width)
+    {
+      for (size_t i = 0; i < count; ++i)
+        for (char32_t c = ranges[i][0]; c <= ranges[i][1]; ++c)
+        {
+          uint8_t &bits = packed[c >> 2];
+          bits = static_cast<uint8_t>((bits & ~(3 << ((c & 3) * 2))) | (width << ((c & 3) * 2)));
+        }
+    };
+    apply(wide, sizeof(wide) / sizeof(wide[0]), 2);
+    apply(zero, sizeof(zero) / sizeof(zero[0]), 0);
+
+    // Share blocks that came out the same.
+    std::map<std::array<uint8_t, 64>, uint8_t> unique;
+    for (size_t block = 0; block < sizeof(Index); ++block)
+    {
+      std::array<uint8_t, 64> bits;
+      std::copy(packed.begin() + block * 64, packed.begin() + (block + 1) * 64, bits.begin());
+      auto found = unique.find(bits);
+      if (found == unique.end())
+      {
+        found = unique.emplace(bits, static_cast<uint8_t>(unique.size())).first;
+        Blocks.insert(Blocks.end(), bits.begin(), bits.end());
+      }
+      Index[block] = found->second;
+    }
+  }
+
+
+  // The table, built the first time it is needed.
+  inline const Unicode::WidthTable &Unicode::widthTable()
+  {
+    static const WidthTable table;
+    return table;
+  }
+
+
+  // Columns a character takes up. Anything below the combining marks is 1 without looking.
+  inline int Unicode::Width(char32_t codePoint)
+  {
+    if (codePoint < 0x300)
+      return 1;
+    if (codePoint >= 0x110000)
+      return 0;
+
+    const WidthTable &table = widthTable();
+    const uint8_t bits = table.Blocks[table.Index[codePoint >> 8] * 64 + ((codePoint & 0xFF) >> 2)];
+    return (bits >> ((codePoint & 3) * 2)) & 3;
+  }
+
+
+  // Reads the next character. Anything malformed, overlong or out of range reads as the
+  // replacement character, stepping past only the bytes that were looked at.
+  inline char32_t Unicode::Decode(const char *&it, const char *end)
+  {
+    const unsigned char lead = static_cast<unsigned char>(*it++);
+    if (lead < 0x80)
+      return lead;
+
+    int extra;
+    char32_t codePoint;
+    if (lead >= 0xC2 && lead < 0xE0)
+    {
+      extra = 1;
+      codePoint = lead & 0x1F;
+    }
+    else if (lead >= 0xE0 && lead < 0xF0)
+    {
+      extra = 2;
+      codePoint = lead & 0x0F;
+    }
+    else if (lead >= 0xF0 && lead < 0xF5)
+    {
+      extra = 3;
+      codePoint = lead & 0x07;
+    }
+    else
+      return Replacement;
+
+    for (int i = 0; i < extra; ++i)
+    {
+      if (it == end || (static_cast<unsigned char>(*it) & 0xC0) != 0x80)
+        return Replacement;
+      codePoint = (codePoint << 6) | (static_cast<unsigned char>(*it++) & 0x3F);
+    }
+
+    if ((extra == 2 && codePoint < 0x800) || (extra == 3 && (codePoint < 0x10000 || codePoint > 0x10FFFF)))
+      return Replacement;
+    if (codePoint >= 0xD800 && codePoint <= 0xDFFF)
+      return Replacement;
+    return codePoint;
+  }
+
+
+  // Writes a character as UTF-8, returning how many bytes it took.
+  inline size_t Unicode::Encode(char *out, char32_t codePoint)
+  {
+    if (codePoint < 0x80)
+    {
+      out[0] = static_cast<char>(codePoint);
+      return 1;
+    }
+    if (codePoint < 0x800)
+    {
+      out[0] = static_cast<char>(0xC0 | (codePoint >> 6));
+      out[1] = static_cast<char>(0x80 | (codePoint & 0x3F));
+      return 2;
+    }
+    if (codePoint < 0x10000)
+    {
+      out[0] = static_cast<char>(0xE0 | (codePoint >> 12));
+      out[1] = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+      out[2] = static_cast<char>(0x80 | (codePoint & 0x3F));
+      return 3;
+    }
+    if (codePoint > 0x10FFFF)
+      return Encode(out, Replacement);
+
+    out[0] = static_cast<char>(0xF0 | (codePoint >> 18));
+    out[1] = static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+    out[2] = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+    out[3] = static_cast<char>(0x80 | (codePoint & 0x3F));
+    return 4;
+  }
+
+
+  // Appends a character as UTF-8.
+  inline void Unicode::Encode(std::string &out, char32_t codePoint)
+  {
+    char bytes[4];
+    out.append(bytes, Encode(bytes, codePoint));
+  }
+
+
+  // Columns a UTF-8 string takes up, a byte at a time while it is ASCII.
+  inline size_t Unicode::TextWidth(const char *text, size_t len)
+  {
+    size_t width = 0;
+    const char *end = text + len;
+    while (text < end)
+    {
+      if (static_cast<unsigned char>(*text) < 0x80)
+      {
+        ++width;
+        ++text;
+        continue;
+      }
+      width += Width(Decode(text, end));
+    }
+    return width;
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////
+//Palette.hpp
+///////////////////////////////////////////////////////////////////////
+#include <cstdlib>          // Color depth from the environment.
+#include <string>           // Escape sequences.
+
+namespace RConsole
+{
+  // The colors output was last left in, so moving to the next ones only has to write what
+  // changed. Output that starts from somewhere unknown resets first.
+  struct Pen
+  {
+    Pen();
+    bool Known;
+    CellColor Fg;
+    CellColor Bg;
+  };
+
+  // Bringing colors down to what a terminal can show, and writing them out as SGR.
+  namespace Palette
+  {
+    // A color as xterm shows it by default, packed as 0xRRGGBB.
+    uint32_t RgbOf(CellColor color);
+
+    // The nearest color the depth can show. Default and basic colors show at any depth.
+    CellColor Quantize(CellColor color, ColorDepth depth);
+
+    // The basic color nearest a color, or the fallback for the default color.
+    Color BasicOf(CellColor color, Color fallback);
+
+    // Best guess at what the terminal shows, from COLORTERM and TERM.
+    ColorDepth DetectDepth();
+
+    // Writes the shortest SGR sequence taking the pen to the colors, if they differ.
+    void Sgr(std::string &out, Pen &pen, CellColor fg, CellColor bg);
+
+    // Nearest colors, precomputed. RGB is looked up at 5 bits a channel.
+    struct Cube
+    {
+      Cube();
+      uint8_t To256[32768];
+      uint8_t To16[32768];
+      uint8_t IndexTo16[256];
+    };
+    const Cube &cube();
+    uint32_t distance(uint32_t lhs, uint32_t rhs);
+    uint8_t nearest16(uint32_t rgb);
+    uint8_t nearest256(uint32_t rgb);
+    char *params(char *it, CellColor color, bool isBackground);
+  }
+
+
+    /////////////////
+   // Pen Methods //
+  /////////////////
+  // Nothing is known about the output yet.
+  inline Pen::Pen() : Known(false), Fg(), Bg()
+  {  }
+
+
+    /////////////////////
+   // Palette Methods //
+  /////////////////////
+  namespace Palette
+  {
+    // The 16 colors in Color order, as xterm has them.
+    static const uint32_t basicRgb[16] = {
+      0x000000, 0x0000EE, 0x00CD00, 0x00CDCD, 0xCD0000, 0xCD00CD, 0xCDCD00, 0xE5E5E5,
+      0x7F7F7F, 0x5C5CFF, 0x00FF00, 0x00FFFF, 0xFF0000, 0xFF00FF, 0xFFFF00, 0xFFFFFF
+    };
+
+    // Color order and SGR order swap blue with red and cyan with brown, both ways.
+    static const uint8_t basicSwap[8] = { 0, 4, 2, 6, 1, 5, 3, 7 };
+
+    // Levels of each channel in the 6x6x6 part of the 256 color palette.
+    static const uint8_t cubeLevels[6] = { 0, 95, 135, 175, 215, 255 };
+  }
+
+
+  // RGB of a color. Palette indices under 16 are the basic colors in SGR order.
+  inline uint32_t Palette::RgbOf(CellColor color)
+  {
+    const uint8_t index = color.GetIndex();
+    switch (color.GetKind())
+    {
+    case CellColor::BASIC:
+      return basicRgb[index & 15];
+    case CellColor::INDEXED:
+      if (index < 16)
+        return basicRgb[basicSwap[index & 7] | (index & 8)];
+      if (index < 232)
+      {
+        const unsigned int cubeIndex = index - 16u;
+        return (cubeLevels[cubeIndex / 36] << 16) | (cubeLevels[(cubeIndex / 6) % 6] << 8) | cubeLevels[cubeIndex % 6];
+      }
+      return (8u + 10u * (index - 232u)) * 0x010101u;
+    case CellColor::RGB:
+      return color.GetBits() & 0xFFFFFF;
+    default:
+      return 0;
+    }
+  }
+
+
+  // Brings a color down to the depth with a lookup.
+  inline CellColor Palette::Quantize(CellColor color, ColorDepth depth)
+  {
+    if (depth == DEPTH_TRUECOLOR)
+      return color;
+
+    const CellColor::Kind kind = color.GetKind();
+    if (kind == CellColor::INDEXED)
+    {
+      if (depth == DEPTH_256)
+        return color;
+      return CellColor(static_cast<Color>(cube().IndexTo16[color.GetIndex()]));
+    }
+    if (kind != CellColor::RGB)
+      return color;
+
+    const unsigned int key = ((color.R() >> 3) << 10) | ((color.G() >> 3) << 5) | (color.B() >> 3);
+    if (depth == DEPTH_256)
+      return CellColor::Indexed(cube().To256[key]);
+    return CellColor(static_cast<Color>(cube().To16[key]));
+  }
+
+
+  // The basic color to use where only those can be shown, like the Windows console.
+  inline Color Palette::BasicOf(CellColor color, Color fallback)
+  {
+    const CellColor basic = Quantize(color, DEPTH_16);
+    if (basic.GetKind() != CellColor::BASIC)
+      return fallback;
+    return static_cast<Color>(basic.GetIndex());
+  }
+
+
+  // Terminals that do 24 bit color say so in COLORTERM, and 256 color ones in TERM.
+  inline ColorDepth Palette::DetectDepth()
+  {
+    const char *colorTerm = getenv("COLORTERM");
+    if (colorTerm != nullptr && (strstr(colorTerm, "truecolor") != nullptr || strstr(colorTerm, "24bit") != nullptr))
+      return DEPTH_TRUECOLOR;
+
+    const char *term = getenv("TERM");
+    if (term != nullptr && strstr(term, "256color") != nullptr)
+      return DEPTH_256;
+    return DEPTH_16;
+  }
+
+
+  // Writes what takes the pen to the colors, either as the changes from the pen or as a
+  // reset followed by whatever isn't the default, whichever is shorter. The basic colors
+  // above 7 are the ones below in bold, so bold is its own change.
+  inline void Palette::Sgr(std::string &out, Pen &pen, CellColor fg, CellColor bg)
+  {
+    if (pen.Known && pen.Fg == fg && pen.Bg == bg)
+      return;
+
+    const bool isBold = fg.GetKind() == CellColor::BASIC && fg.GetIndex() >= 8;
+    char reset[64];
+    char *r = reset;
+    *r++ = '0';
+    if (isBold)
+    {
+      *r++ = ';';
+      *r++ = '1';
+    }
+    if (fg.GetKind() != CellColor::DEFAULT)
+    {
+      *r++ = ';';
+      r = params(r, fg, false);
+    }
+    if (bg.GetKind() != CellColor::DEFAULT)
+    {
+      *r++ = ';';
+      r = params(r, bg, true);
+    }
+
+    // Every change starts with a separator, and the first is dropped.
+    char delta[64];
+    char *d = delta;
+    if (pen.Known)
+    {
+      const bool wasBold = pen.Fg.GetKind() == CellColor::BASIC && pen.Fg.GetIndex() >= 8;
+      if (wasBold != isBold)
+      {
+        const char *bold = isBold ? ";1" : ";22";
+        while (*bold != '\0')
+          *d++ = *bold++;
+      }
+
+      const uint32_t was = pen.Fg.GetBits() & ~(wasBold ? 8u : 0u);
+      const uint32_t is = fg.GetBits() & ~(isBold ? 8u : 0u);
+      if (was != is)
+      {
+        *d++ = ';';
+        d = params(d, fg, false);
+      }
+      if (pen.Bg != bg)
+      {
+        *d++ = ';';
+        d = params(d, bg, true);
+      }
+    }
+
+    const char *best = reset;
+    size_t len = static_cast<size_t>(r - reset);
+    if (pen.Known && static_cast<size_t>(d - delta) - 1 <= len)
+    {
+      best = delta + 1;
+      len = static_cast<size_t>(d - delta) - 1;
+    }
+
+    out += "\033[";
+    out.append(best, len);
+    out += 'm';
+
+    pen.Known = true;
+    pen.Fg = fg;
+    pen.Bg = bg;
+  }
+
+
+  // Builds the lookups the first time a color is quantized.
+  inline const Palette::Cube &Palette::cube()
+  {
+    static const Cube table;
+    return table;
+  }
+
+
+  // Fills in the nearest color for the middle of each RGB cell, and for each palette index.
+  inline Palette::Cube::Cube()
+  {
+    for (unsigned int key = 0; key < 32768; ++key)
+    {
+      const uint32_t rgb = ((((key >> 10) & 31) << 3 | 4) << 16) | ((((key >> 5) & 31) << 3 | 4) << 8) | ((key & 31) << 3 | 4);
+      To256[key] = nearest256(rgb);
+      To16[key] = nearest16(rgb);
+    }
+
+    for (unsigned int index = 0; index < 256; ++index)
+    {
+      if (index < 16)
+        IndexTo16[index] = static_cast<uint8_t>(basicSwap[index & 7] | (index & 8));
+      else
+        IndexTo16[index] = nearest16(RgbOf(CellColor::Indexed(static_cast<uint8_t>(index))));
+    }
+  }
+
+
+  // Squared distance between colors, weighted towards green the way eyes are.
+  inline uint32_t Palette::distance(uint32_t lhs, uint32_t rhs)
+  {
+    const int r = static_cast<int>((lhs >> 16) & 0xFF) - static_cast<int>((rhs >> 16) & 0xFF);
+    const int g = static_cast<int>((lhs >> 8) & 0xFF) - static_cast<int>((rhs >> 8) & 0xFF);
+    const int b = static_cast<int>(lhs & 0xFF) - static_cast<int>(rhs & 0xFF);
+    return static_cast<uint32_t>(2 * r * r + 4 * g * g + 3 * b * b);
+  }
+
+
+  // The nearest basic color, by trying all of them.
+  inline uint8_t Palette::nearest16(uint32_t rgb)
+  {
+    uint8_t best = 0;
+    for (uint8_t color = 1; color < 16; ++color)
+      if (distance(rgb, basicRgb[color]) < distance(rgb, basicRgb[best]))
+        best = color;
+    return best;
+  }
+
+
+  // The nearest of the 6x6x6 cube and the grey ramp. The first 16 are left out, since
+  // terminals theme those however they like.
+  inline uint8_t Palette::nearest256(uint32_t rgb)
+  {
+    unsigned int cubeIndex = 16;
+    unsigned int scale = 36;
+    for (int shift = 16; shift >= 0; shift -= 8)
+    {
+      const unsigned int channel = (rgb >> shift) & 0xFF;
+      const unsigned int level = (channel < 48) ? 0 : (channel < 115) ? 1 : (channel - 35) / 40;
+      cubeIndex += level * scale;
+      scale /= 6;
+    }
+
+    const unsigned int average = (((rgb >> 16) & 0xFF) + ((rgb >> 8) & 0xFF) + (rgb & 0xFF)) / 3;
+    const unsigned int greyIndex = 232 + ((average < 8) ? 0 : (average >= 238) ? 23 : (average - 3) / 10);
+
+    const uint32_t cubeDistance = distance(rgb, RgbOf(CellColor::Indexed(static_cast<uint8_t>(cubeIndex))));
+    const uint32_t greyDistance = distance(rgb, RgbOf(CellColor::Indexed(static_cast<uint8_t>(greyIndex))));
+    return static_cast<uint8_t>((greyDistance < cubeDistance) ? greyIndex : cubeIndex);
+  }
+
+
+  // Writes the parameters that select a color, without separators around them.
+  inline char *Palette::params(char *it, CellColor color, bool isBackground)
+  {
+    unsigned int values[5];
+    size_t count = 0;
+    const unsigned int base = isBackground ? 40 : 30;
+    switch (color.GetKind())
+    {
+    case CellColor::BASIC:
+      // Bright backgrounds have their own codes, bright foregrounds are bold.
+      if (isBackground && color.GetIndex() >= 8)
+        values[count++] = 100 + basicSwap[color.GetIndex() & 7];
+      else
+        values[count++] = base + basicSwap[color.GetIndex() & 7];
+      break;
+    case CellColor::INDEXED:
+      values[count++] = base + 8;
+      values[count++] = 5;
+      values[count++] = color.GetIndex();
+      break;
+    case CellColor::RGB:
+      values[count++] = base + 8;
+      values[count++] = 2;
+      values[count++] = color.R();
+      values[count++] = color.G();
+      values[count++] = color.B();
+      break;
+    default:
+      values[count++] = base + 9;
+      break;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+      if (i > 0)
+        *it++ = ';';
+
+      const unsigned int value = values[i];
+      if (value >= 100)
+        *it++ = static_cast<char>('0' + value / 100);
+      if (value >= 10)
+        *it++ = static_cast<char>('0' + (value / 10) % 10);
+      *it++ = static_cast<char>('0' + value % 10);
+    }
+    return it;
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////
+//CanvasRaster.hpp
+///////////////////////////////////////////////////////////////////////
+#include <string>           // Layer names.
+#include <vector>           // Layer list.
+
+namespace RConsole
+{
+  // The raster info struct, holds info on what is to be drawn at a location and the colors.
+  struct RasterInfo
+  {
+    RasterInfo();
+    RasterInfo(const char32_t val, CellColor col, CellColor bg = CellColor());
+    bool operator ==(const RasterInfo &rhs) const;
+    bool operator !=(const RasterInfo &rhs) const;
+    char32_t Value;
+    CellColor C;
+    CellColor Bg;
+  };
+
+  // A rectangle of cells, from X1, Y1 up to but not including X2, Y2.
+  struct CanvasRect
+  {
+    CanvasRect();
+    CanvasRect(unsigned int x1, unsigned int y1, unsigned int x2, unsigned int y2);
+    bool Empty() const;
+    bool Contains(unsigned int x, unsigned int y) const;
+    bool Overlaps(const CanvasRect &rhs) const;
+    void Merge(const CanvasRect &rhs);
+    void Clip(unsigned int width, unsigned int height);
+    unsigned int X1;
+    unsigned int Y1;
+    unsigned int X2;
+    unsigned int Y2;
+  };
+
+  // Console raster class
+  class Terminal;
+  class CanvasRaster
+  {
+    friend Terminal;
+
+  public:
+    // Constructors
+    CanvasRaster(unsigned int width, unsigned int height);
+
+    // Method Prototypes
+    CanvasRect WriteChar(char32_t toDraw, float x, float y, CellColor color = PREVIOUS_COLOR, CellColor background = CellColor());
+	  CanvasRect WriteString(const char *toWrite, size_t len, float x, float y, CellColor color = PREVIOUS_COLOR, CellColor background = CellColor());
+    const Field2D<RasterInfo>& GetRasterData() const;
+    void Fill(const RasterInfo &ri);
+    void Zero();
+    void CopyFrom(const CanvasRaster &rhs);
+    void Resize(unsigned int width, unsigned int height);
+    void Reshape(unsigned int width, unsigned int height, const RasterInfo &exposed);
+    CanvasRect Blit(const Field2D<RasterInfo> &cells, int x, int y);
+    CanvasRect FillRect(const RasterInfo &ri, int x, int y, unsigned int width, unsigned int height);
+
+    // General
+    unsigned int GetRasterWidth() const;
+    unsigned int GetRasterHeight() const;
+
+  private:
+    // Private member functions
+    Field2D<RasterInfo>& GetRasterData();
+    CanvasRect clip(int x, int y, unsigned int width, unsigned int height) const;
+
+    // Variables
+    unsigned int width_;
+    unsigned int height_;
+    Field2D<RasterInfo> data_;
+
+  };
+
+  // A named raster composited over the ones with a lower Z. Cells never drawn to are
+  // see-through, unless they fall in the opaque area.
+  struct CanvasLayer
+  {
+    CanvasLayer(const std::string &name, int z, unsigned int width, unsigned int height);
+    void Touch(unsigned int begin, unsigned int end);
+    void Clear();
+    std::string Name;
+    int Z;
+    bool Visible;
+    CanvasRect Opaque;
+    CanvasRect Dirty;
+    CanvasRect Extent;
+    CanvasRaster Raster;
+  };
+}
+
+
+///////////////////////////////////////////////////////////////////////
+//OutputSink.hpp
+///////////////////////////////////////////////////////////////////////
+#include <cstdio>           // FILE output.
+#include <cerrno>           // Interrupted writes.
+#include <iostream>         // Keeping cout in order.
+#include <string>           // Memory buffer.
+#ifdef OS_WINDOWS
+  #include <io.h>           // _write to descriptors.
+#else
+  #include <sys/socket.h>   // send.
+#endif
+
+namespace RConsole
+{
+  // Where a terminal's output goes. Each update is handed over in a single write, once
+  // it is fully encoded.
+  class OutputSink
+  {
+  public:
+    virtual ~OutputSink() {}
+    virtual void Write(const char *data, size_t size) = 0;
+  };
+
+
+  // Writes to a file descriptor, like a tty. Short and interrupted writes are retried.
+  class FdSink : public OutputSink
+  {
+  public:
+    FdSink(int fd);
+    void Write(const char *data, size_t size) override;
+    int GetFd() const;
+
+  private:
+    int fd_;
+  };
+
+
+  // Writes to a FILE, flushing it after each update.
+  class FileSink : public OutputSink
+  {
+  public:
+    FileSink(FILE *fp);
+    void Write(const char *data, size_t size) override;
+
+  private:
+    FILE *fp_;
+  };
+
+
+  // Keeps everything written in a buffer, with no terminal at all. Clearing keeps the
+  // memory, so rendering frame after frame into it stops allocating.
+  class MemorySink : public OutputSink
+  {
+  public:
+    MemorySink();
+    void Write(const char *data, size_t size) override;
+    const char *GetData() const;
+    size_t GetSize() const;
+    void Clear();
+
+  private:
+    std::string data_;
+  };
+
+
+#ifndef OS_WINDOWS
+  // Writes to a connected socket. A peer that went away doesn't raise SIGPIPE, the sink
+  // just closes and drops anything written after. On a non-blocking socket, what the
+  // socket won't take right away is kept in order until Flush gets it out, so a peer that
+  // stops reading never blocks the writer.
+  class SocketSink : public OutputSink
+  {
+  public:
+    SocketSink(int fd);
+    void Write(const char *data, size_t size) override;
+    bool Flush();
+    size_t GetPending() const;
+    bool IsOpen() const;
+
+  private:
+    size_t sendSome(const char *data, size_t size);
+    int fd_;
+    bool isOpen_;
+    std::string pending_;
+    size_t sent_;
+  };
+#endif
+
+
+    //////////////////////////
+   // Output Sink Methods //
+  //////////////////////////
+  // Writes to the descriptor as is.
+  inline FdSink::FdSink(int fd) : fd_(fd)
+  {  }
+
+
+  // Writes everything, unless the descriptor stops taking it. Anything written to stdout
+  // through cout or stdio goes first, so it stays in order.
+  inline void FdSink::Write(const char *data, size_t size)
+  {
+    if (fd_ == 1)
+    {
+      std::cout.flush();
+      fflush(stdout);
+    }
+
+    size_t written = 0;
+    while (written < size)
+    {
+      #ifdef OS_WINDOWS
+      const int count = _write(fd_, data + written, static_cast<unsigned int>(size - written));
+      #else
+      const ssize_t count = write(fd_, data + written, size - written);
+      if (count < 0 && errno == EINTR)
+        continue;
+      #endif
+
+      if (count <= 0)
+        break;
+      written += static_cast<size_t>(count);
+    }
+  }
+
+
+  // Gets the descriptor written to.
+  inline int FdSink::GetFd() const
+  {
+    return fd_;
+  }
+
+
+  // Writes to the file, which stays open.
+  inline FileSink::FileSink(FILE *fp) : fp_(fp)
+  {  }
+
+
+  // Writes and flushes, so each update shows up whole.
+  inline void FileSink::Write(const char *data, size_t size)
+  {
+    fwrite(data, 1, size, fp_);
+    fflush(fp_);
+  }
+
+
+  // Starts out empty.
+  inline MemorySink::MemorySink() : data_()
+  {  }
+
+
+  // Appends to the buffer.
+  inline void MemorySink::Write(const char *data, size_t size)
+  {
+    data_.append(data, size);
+  }
+
+
+  // Everything written since the last clear.
+  inline const char *MemorySink::GetData() const
+  {
+    return data_.data();
+  }
+
+
+  inline size_t MemorySink::GetSize() const
+  {
+    return data_.size();
+  }
+
+
+  // Empties the buffer, keeping its memory.
+  inline void MemorySink::Clear()
+  {
+    data_.clear();
+  }
+
+
+#ifndef OS_WINDOWS
+  // Writes to the socket, which stays open.
+  inline SocketSink::SocketSink(int fd) : fd_(fd), isOpen_(true), pending_(), sent_(0)
+  {  }
+
+
+  // Sends what the socket takes, keeping the rest. Anything already kept goes first.
+  inline void SocketSink::Write(const char *data, size_t size)
+  {
+    if (sent_ < pending_.size())
+    {
+      pending_.append(data, size);
+      return;
+    }
+
+    const size_t written = sendSome(data, size);
+    if (isOpen_ && written < size)
+      pending_.assign(data + written, size - written);
+  }
+
+
+  // Sends what was kept, as far as the socket takes it. Returns if nothing is left.
+  inline bool SocketSink::Flush()
+  {
+    if (sent_ < pending_.size())
+      sent_ += sendSome(pending_.data() + sent_, pending_.size() - sent_);
+
+    if (sent_ < pending_.size())
+      return false;
+
+    pending_.clear();
+    sent_ = 0;
+    return true;
+  }
+
+
+  // Bytes written but not sent yet.
+  inline size_t SocketSink::GetPending() const
+  {
+    return pending_.size() - sent_;
+  }
+
+
+  // If the peer is still taking output.
+  inline bool SocketSink::IsOpen() const
+  {
+    return isOpen_;
+  }
+
+
+  // Sends until done or the socket is full. Once the peer is gone, nothing more is sent
+  // and nothing is kept. Returns the bytes sent.
+  inline size_t SocketSink::sendSome(const char *data, size_t size)
+  {
+    #ifdef MSG_NOSIGNAL
+    const int flags = MSG_NOSIGNAL;
+    #else
+    const int flags = 0;
+    #endif
+
+    size_t written = 0;
+    while (isOpen_ && written < size)
+    {
+      const ssize_t count = send(fd_, data + written, size - written, flags);
+      if (count < 0 && errno == EINTR)
+        continue;
+      if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        break;
+
+      if (count <= 0)
+      {
+        isOpen_ = false;
+        pending_.clear();
+        sent_ = 0;
+      }
+      else
+        written += static_cast<size_t>(count);
+    }
+
+    return written;
+  }
+#endif
+}
+
+
+///////////////////////////////////////////////////////////////////////
+//Terminal.hpp
+///////////////////////////////////////////////////////////////////////
+#include <condition_variable> // Waking band workers.
+#include <csignal>          // Resize flag.
+#include <functional>       // Band jobs.
+#include <memory>           // Owned band pool.
+#include <mutex>            // Band pool state.
+#include <thread>           // Band workers.
+
+namespace RConsole
+{
+  // Threads that run the bands of one job side by side. The calling thread takes part, and
+  // Run returns once every band is done.
+  class BandPool
+  {
+  public:
+    // Constructor and Destructor
+    BandPool(size_t threads);
+    ~BandPool();
+
+    // Member Functions
+    size_t GetThreadCount() const;
+    void Run(size_t count, const std::function<void(size_t)> &job);
+
+  private:
+    // No copying, the threads are owned.
+    BandPool(const BandPool &rhs) = delete;
+    BandPool &operator=(const BandPool &rhs) = delete;
+
+    // Private methods
+    void work();
+    bool take(std::unique_lock<std::mutex> &lock);
+
+    // Variables
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const std::function<void(size_t)> *job_;
+    size_t next_;
+    size_t count_;
+    size_t finished_;
+    bool running_;
+  };
+
+
+  // The cells an update changed on screen, as rectangles with their contents row by row.
+  // Changes close together are covered by one rectangle, unchanged cells and all, so there
+  // are few of them. Kept from update to update, so once grown it fills without allocating.
+  // A cell covered by the wide character to its left has a Value of 0, keeping its colors.
+  class FrameDamage
+  {
+    friend Terminal;
+
+  public:
+    // Constructor
+    FrameDamage();
+
+    // Member Functions
+    size_t GetCount() const;
+    const CanvasRect &GetRect(size_t index) const;
+    const RasterInfo *GetCells(size_t index) const;
+    void Clear();
+
+  private:
+    // Variables
+    std::vector<CanvasRect> rects_;
+    std::vector<size_t> offsets_;
+    std::vector<RasterInfo> cells_;
+    size_t open_;
+  };
+
+
+  // A screen to draw to, with its own rasters and size. Output is buffered and written to
+  // the output file descriptor on update, so one process can drive any number of them,
+  // such as one per pty or socket session.
+  class Terminal
+  {
+  public:
+    // Constructors
+    Terminal(unsigned int width, unsigned int height, int outputFd = 1, int inputFd = 0);
+    ~Terminal();
+
+    // Init call
+    void ReInit(unsigned int width, unsigned int height);
+    void Resize(unsigned int width, unsigned int height);
+
+    // Basic drawing calls
+    bool Update(FrameDamage *damage = nullptr);
+    void FillCanvas(const RasterInfo &ri = RasterInfo(' ', WHITE));
+    void Draw(char32_t toWrite, float x, float y, CellColor color = PREVIOUS_COLOR, CellColor background = CellColor());
+	  void DrawString(const char* toDraw, float xStart, float yStart, CellColor color = PREVIOUS_COLOR, CellColor background = CellColor());
+    void DrawString(const char* toDraw, size_t len, float xStart, float yStart, CellColor color = PREVIOUS_COLOR, CellColor background = CellColor());
+    void DrawRaster(const CanvasRaster &raster, unsigned int x, unsigned int y, unsigned int width, unsigned int height);
+    void DrawTiled(const TiledField2D<RasterInfo> &field, unsigned int viewX, unsigned int viewY);
+    void DrawAlpha(float x, float y, CellColor color, float opacity);
+    void Shutdown();
+
+    // Advanced drawing calls
+    void DrawPartialPoint(float x, float y, CellColor color);
+    void DrawBox(char32_t toWrite, float x1, float y1, float x2, float y2, CellColor color);
+    void Blit(const Field2D<RasterInfo> &cells, int x, int y);
+    void FillRect(const RasterInfo &ri, int x, int y, unsigned int width, unsigned int height);
+    void SetCursorVisible(bool isVisible);
+    void SetRetained(bool isRetained);
+    void SetBands(unsigned int threads);
+    void SetColorDepth(ColorDepth depth);
+    void SetSink(OutputSink *sink);
+    void ClearScreen();
+
+    // Layers. Drawing goes to the current layer, and Update composites what changed.
+    void CreateLayer(const std::string &name, int z);
+    void RemoveLayer(const std::string &name);
+    void SetLayer(const std::string &name = "");
+    void SetLayerVisible(const std::string &name, bool isVisible);
+    void SetLayerOpaque(const std::string &name, unsigned int x, unsigned int y, unsigned int width, unsigned int height);
+    void ClearLayer(const std::string &name);
+    void DumpRaster(FILE *fp = stdout) const;
+    void CropRaster(FILE *fp = stdout, char toTrim = ' ') const;
+
+    // Input, read without blocking. Returns the bytes read, 0 if there were none, or -1
+    // once the input is closed.
+    int Read(char *buffer, size_t size);
+
+    // Data related calls
+    unsigned int GetConsoleWidht() const;
+    unsigned int GetConsoleHeight() const;
+    ColorDepth GetColorDepth() const;
+    OutputSink *GetSink() const;
+    int GetOutputFd() const;
+    int GetInputFd() const;
+
+  private:
+    // No copying, the layers are owned.
+    Terminal(const Terminal &rhs) = delete;
+    Terminal &operator=(const Terminal &rhs) = delete;
+    
+    // Private methods.
+    void clearPrevious(std::string &out, Pen &pen, unsigned int begin, unsigned int end);
+    void fullClear();
+    void setColor(std::string &out, Pen &pen, CellColor fg, CellColor bg);
+    void locate(std::string &out, unsigned int x, unsigned int y);
+    void putC(std::string &out, char32_t character);
+    void flush();
+    bool writeRaster(const CanvasRaster &r, std::string &out, Pen &pen, unsigned int begin, unsigned int end);
+    void writeRetained(std::string &out, Pen &pen, unsigned int begin, unsigned int end);
+    void encode(unsigned int begin, unsigned int end);
+    void encodeBand(std::string &out, Pen &pen, unsigned int begin, unsigned int end);
+    void markDirty(unsigned int begin, unsigned int end);
+    void touch(unsigned int begin, unsigned int end);
+    void touch(const CanvasRect &area);
+    void exportDamage(FrameDamage &damage);
+    void addDamage(FrameDamage &damage, unsigned int y, unsigned int x1, unsigned int x2) const;
+    static RasterInfo shown(const RasterInfo &ri);
+    CanvasRaster &target();
+    CanvasLayer *findLayer(const std::string &name);
+    void composite();
+    unsigned int occludedUntil(unsigned int x, unsigned int y, size_t above) const;
+    RasterInfo resolve(unsigned int x, unsigned int y) const;
+
+    // Any rasters we have. Could be expanded to have two, so you could "swap" them,
+    // Although practicality of that is limited given the clearing technique.
+    CanvasRaster r_;
+    CanvasRaster prev_;
+
+    // The tabs on what was last modified. This is important, because we will only update
+    // what we care about.
+    bool isDrawing_;
+    unsigned int width_;
+    unsigned int height_;
+    DirtyMask modified_;
+
+    // Retained mode keeps the raster between updates, so only the span of cells drawn
+    // to since the last update has to be looked at.
+    bool isRetained_;
+    unsigned int dirtyBegin_;
+    unsigned int dirtyEnd_;
+
+    // Layers from the lowest Z up. Once any is created, everything drawn without picking a
+    // layer goes to the base layer, and only the compositor writes to the raster.
+    struct Damage
+    {
+      CanvasRect Area;
+      size_t Above;
+    };
+    std::vector<CanvasLayer *> layers_;
+    CanvasLayer *layer_;
+    CanvasLayer *base_;
+    std::vector<Damage> damage_;
+
+    // Where output goes and input comes from. Output is collected here until flushed to
+    // the sink, which is the output descriptor unless another was set. The Windows console
+    // is driven through its API instead.
+    FdSink fdSink_;
+    OutputSink *sink_;
+    int inputFd_;
+    bool isConsole_;
+    std::string out_;
+
+    // Colors are written at this depth, and only when they change from the pen.
+    ColorDepth depth_;
+    Pen pen_;
+
+    // Updates touching at least BandMinimum cells are encoded a band of rows per thread,
+    // each into its own buffer, once SetBands gave it threads.
+    static const unsigned int BandMinimum = 16384;
+    std::unique_ptr<BandPool> bands_;
+    std::vector<std::string> bandOut_;
+    std::vector<Pen> bandPen_;
+
+    // Changed cells at most DamageGap apart on a row are exported as one rectangle.
+    static const unsigned int DamageGap = 4;
+  };
+}
+
+
+///////////////////////////////////////////////////////////////////////
+//Canvas.hpp
+///////////////////////////////////////////////////////////////////////
+
+
+namespace RConsole
+{
+  // The process wide terminal, drawing to standard output. Every call goes to Default().
+  class Canvas
+  {
+  public:
+    // Init call
+    static void ReInit(unsigned int width, unsigned int height)    { terminal_.ReInit(width, height); }
+    static void Resize(unsigned int width, unsigned int height)    { terminal_.Resize(width, height); }
+    static bool PollResize();
+
+    // Basic drawing calls
+    static bool Update(FrameDamage *damage = nullptr);
+    static void FillCanvas(const RasterInfo &ri = RasterInfo(' ', WHITE))                  { terminal_.FillCanvas(ri); }
+    static void Draw(char32_t toWrite, float x, float y, CellColor color = PREVIOUS_COLOR, CellColor background = CellColor()) { terminal_.Draw(toWrite, x, y, color, background); }
+	  static void DrawString(const char* toDraw, float xStart, float yStart, CellColor color = PREVIOUS_COLOR, CellColor background = CellColor())             { terminal_.DrawString(toDraw, xStart, yStart, color, background); }
+    static void DrawString(const char* toDraw, size_t len, float xStart, float yStart, CellColor color = PREVIOUS_COLOR, CellColor background = CellColor()) { terminal_.DrawString(toDraw, len, xStart, yStart, color, background); }
+    static void DrawRaster(const CanvasRaster &raster, unsigned int x, unsigned int y, unsigned int width, unsigned int height) { terminal_.DrawRaster(raster, x, y, width, height); }
+    static void DrawTiled(const TiledField2D<RasterInfo> &field, unsigned int viewX, unsigned int viewY)               { terminal_.DrawTiled(field, viewX, viewY); }
+    static void DrawAlpha(float x, float y, CellColor color, float opacity)                { terminal_.DrawAlpha(x, y, color, opacity); }
+    static void Shutdown()                                                                 { terminal_.Shutdown(); }
+
+    // Advanced drawing calls
+    static void DrawPartialPoint(float x, float y, CellColor color)                        { terminal_.DrawPartialPoint(x, y, color); }
+    static void Blit(const Field2D<RasterInfo> &cells, int x, int y)                       { terminal_.Blit(cells, x, y); }
+    static void FillRect(const RasterInfo &ri, int x, int y, unsigned int width, unsigned int height) { terminal_.FillRect(ri, x, y, width, height); }
+    static void DrawBox(char32_t toWrite, float x1, float y1, float x2, float y2, CellColor color) { terminal_.DrawBox(toWrite, x1, y1, x2, y2, color); }
+    static void SetCursorVisible(bool isVisible)                                           { terminal_.SetCursorVisible(isVisible); }
+    static void ClearScreen()                                                              { terminal_.ClearScreen(); }
+    static void SetRetained(bool isRetained)                                               { terminal_.SetRetained(isRetained); }
+    static void SetBands(unsigned int threads)                                             { terminal_.SetBands(threads); }
+    static void SetColorDepth(ColorDepth depth)                                            { terminal_.SetColorDepth(depth); }
+    static void SetSink(OutputSink *sink)                                                  { terminal_.SetSink(sink); }
+
+    // Layers
+    static void CreateLayer(const std::string &name, int z)                                { terminal_.CreateLayer(name, z); }
+    static void RemoveLayer(const std::string &name)                                       { terminal_.RemoveLayer(name); }
+    static void SetLayer(const std::string &name = "")                                     { terminal_.SetLayer(name); }
+    static void SetLayerVisible(const std::string &name, bool isVisible)                   { terminal_.SetLayerVisible(name, isVisible); }
+    static void SetLayerOpaque(const std::string &name, unsigned int x, unsigned int y, unsigned int width, unsigned int height) { terminal_.SetLayerOpaque(name, x, y, width, height); }
+    static void ClearLayer(const std::string &name)                                        { terminal_.ClearLayer(name); }
+    static void DumpRaster(FILE *fp = stdout)                                              { terminal_.DumpRaster(fp); }
+    static void CropRaster(FILE *fp = stdout, char toTrim = ' ')                           { terminal_.CropRaster(fp, toTrim); }
+
+    // Data related calls
+    static unsigned int GetConsoleWidht()  { return terminal_.GetConsoleWidht(); }
+    static unsigned int GetConsoleHeight() { return terminal_.GetConsoleHeight(); }
+    static Terminal &Default()             { return terminal_; }
+
+  private:
+    // Hidden Constructors- no instantiating publicly!
+    Canvas() { };
+    Canvas(const Canvas &rhs) { *this = rhs; }
+    
+    // Private methods.
+    static void setCloseHandler();
+    static void setResizeHandler();
+    static void onResize(int signalNum);
+
+    // The terminal itself.
+    static Terminal terminal_;
+    static bool hasLazyInit_;
+
+    // Set from the SIGWINCH handler, so it can only be a flag.
+    static volatile sig_atomic_t resized_;
+  };
+}
+
+///////////////////////////////////////////////////////////////////////
+//CanvasRaster.cpp
+///////////////////////////////////////////////////////////////////////
+
+
+
+namespace RConsole
+{
+   /////////////////////////
+   // Raster info object //
+  ////////////////////////
+  // 
+  //constructor, no character and just the previous color.
+  inline RasterInfo::RasterInfo() : Value(0), C(Color::PREVIOUS_COLOR), Bg()
+  {  }
+
+  
+  // Non-Default constructor, specifies const character and colors.
+  inline RasterInfo::RasterInfo(const char32_t val, CellColor col, CellColor bg) : Value(val), C(col), Bg(bg)
+  {  }
+
+
+  // Overloaded comparision operator that checks all fields.
+  inline bool RasterInfo::operator ==(const RasterInfo &rhs) const
+  {
+    if (rhs.C == C && rhs.Bg == Bg && rhs.Value == Value)
+      return true;
+    return false;
+  }
+
+
+  // Overloaded comparison operator that checks all fields.
+  inline bool RasterInfo::operator !=(const RasterInfo &rhs) const
+  {
+    return !(*this == rhs);
+  }
+
+
+    ///////////////////////////
+   // Console Raster object //
+  ///////////////////////////
+  // Default constructor for the CanvasRaster- Zeros data and gets width and height.
+  inline CanvasRaster::CanvasRaster(unsigned int width, unsigned int height)
+    : width_(width)
+    , height_(height)
+    , data_(width, height, RasterInfo(' ', RConsole::WHITE))
+  {  }
+
+
+  // Draws a character to the screen. Returns the cells written to, which take in any
+  // other half of a wide character that had to be blanked.
+  inline CanvasRect CanvasRaster::WriteChar(char32_t toDraw, float x, float y, CellColor color, CellColor background)
+  {
+    char bytes[4];
+    return WriteString(bytes, Unicode::Encode(bytes, toDraw), x, y, color, background);
+  }
+
+
+  // Writes a UTF-8 string to the field, cut off at the right edge. Wide characters take
+  // two cells, the second holding a continuation, and zero width ones are left out.
+  // Writing over half of a wide character blanks the other half, so the cells written to
+  // are returned.
+  inline CanvasRect CanvasRaster::WriteString(const char *toWrite, size_t len, float x, float y, CellColor color, CellColor background)
+  {
+    #ifdef RConsole_CLIP_CONSOLE
+
+    if (x >= width_) return CanvasRect();
+    if (y >= height_) return CanvasRect();
+
+    #endif // RConsole_CLIP_CONSOLE
+
+    const unsigned int row = static_cast<unsigned int>(y);
+    const Field2DRow<RasterInfo> cells = data_.Row(row);
+    unsigned int col = static_cast<unsigned int>(x);
+    unsigned int begin = col;
+    if (col > 0 && col < width_ && cells[col].Value == Unicode::Continuation)
+    {
+      cells[col - 1].Value = ' ';
+      --begin;
+    }
+
+	  // ASCII is copied straight across, anything else is decoded first.
+    const char *end = toWrite + len;
+    while (toWrite < end && col < width_)
+    {
+      const unsigned char byte = static_cast<unsigned char>(*toWrite);
+      if (byte < 0x80)
+      {
+        cells[col++] = RasterInfo(byte, color, background);
+        ++toWrite;
+        continue;
+      }
+
+      const char32_t codePoint = Unicode::Decode(toWrite, end);
+      const int width = Unicode::Width(codePoint);
+      if (width == 0)
+        continue;
+      if (width == 1)
+      {
+        cells[col++] = RasterInfo(codePoint, color, background);
+        continue;
+      }
+
+      // A wide character that doesn't fit is cut off like anything else.
+      if (col + 1 >= width_)
+      {
+        cells[col++] = RasterInfo(' ', color, background);
+        break;
+      }
+      cells[col++] = RasterInfo(codePoint, color, background);
+      cells[col++] = RasterInfo(Unicode::Continuation, color, background);
+    }
+
+    unsigned int last = col;
+    if (col < width_ && cells[col].Value == Unicode::Continuation)
+    {
+      cells[col].Value = ' ';
+      ++last;
+    }
+
+    if (begin >= last)
+      return CanvasRect();
+	  return CanvasRect(begin, row, last, row + 1);
+  }
+
+
+  // Writes a mass of spaces to the screen.
+  inline void CanvasRaster::Fill(const RasterInfo &ri)
+  {
+    data_.Fill(ri);
+  }
+  
+
+  // Clears out all of the data written to the raster. Does NOT move cursor to 0,0.
+  inline void CanvasRaster::Zero()
+  {
+    data_.Zero();
+  }
+
+
+  // Copies every cell of a raster of the same size, without reallocating.
+  inline void CanvasRaster::CopyFrom(const CanvasRaster &rhs)
+  {
+    if (rhs.width_ != width_ || rhs.height_ != height_)
+      return;
+
+    data_ = rhs.data_;
+  }
+
+
+  // Copies a block of cells, like a sprite or a prerendered widget, with its top left at
+  // X, Y. Whatever falls outside the raster is cut off, and rows are copied whole. Returns
+  // the area written to, which is empty if none of it was on the raster.
+  inline CanvasRect CanvasRaster::Blit(const Field2D<RasterInfo> &cells, int x, int y)
+  {
+    const CanvasRect area = clip(x, y, cells.Width(), cells.Height());
+    if (area.Empty())
+      return area;
+
+    const unsigned int srcX = area.X1 - x;
+    for (unsigned int row = area.Y1; row < area.Y2; ++row)
+    {
+      const RasterInfo *src = cells.Row(row - y).begin() + srcX;
+      std::copy(src, src + (area.X2 - area.X1), data_.Row(row).begin() + area.X1);
+    }
+    return area;
+  }
+
+
+  // Fills a rectangle with a cell, cut off at the edges. Returns the area written to.
+  inline CanvasRect CanvasRaster::FillRect(const RasterInfo &ri, int x, int y, unsigned int width, unsigned int height)
+  {
+    const CanvasRect area = clip(x, y, width, height);
+    for (unsigned int row = area.Y1; row < area.Y2; ++row)
+      data_.Fill(ri, row * width_ + area.X1, row * width_ + area.X2);
+    return area;
+  }
+
+
+  // Resizes to blank, like a new raster, keeping the buffer when it is big enough.
+  inline void CanvasRaster::Resize(unsigned int width, unsigned int height)
+  {
+    width_ = width;
+    height_ = height;
+    data_.Resize(width, height);
+    data_.Fill(RasterInfo(' ', RConsole::WHITE));
+  }
+
+
+  // Resizes keeping the cells both sizes share. Cells that weren't there before are set to
+  // the exposed value, and wide characters cut in half by a new right edge are blanked.
+  inline void CanvasRaster::Reshape(unsigned int width, unsigned int height, const RasterInfo &exposed)
+  {
+    const unsigned int oldWidth = width_;
+    const unsigned int oldHeight = height_;
+    width_ = width;
+    height_ = height;
+    data_.Reshape(width, height);
+
+    if (width < oldWidth && width > 0)
+    {
+      for (unsigned int y = 0; y < height && y < oldHeight; ++y)
+      {
+        RasterInfo &edge = data_.Row(y)[width - 1];
+        if (Unicode::Width(edge.Value) == 2)
+          edge.Value = ' ';
+      }
+    }
+
+    if (exposed == RasterInfo())
+      return;
+    FillRect(exposed, static_cast<int>(oldWidth), 0, (width > oldWidth) ? width - oldWidth : 0, std::min(height, oldHeight));
+    FillRect(exposed, 0, static_cast<int>(oldHeight), width, (height > oldHeight) ? height - oldHeight : 0);
+  }
+
+
+  // The part of a rectangle at X, Y that is on the raster.
+  inline CanvasRect CanvasRaster::clip(int x, int y, unsigned int width, unsigned int height) const
+  {
+    const long long x1 = std::max<long long>(x, 0);
+    const long long y1 = std::max<long long>(y, 0);
+    const long long x2 = std::min<long long>(static_cast<long long>(x) + width, width_);
+    const long long y2 = std::min<long long>(static_cast<long long>(y) + height, height_);
+    if (x1 >= x2 || y1 >= y2)
+      return CanvasRect();
+    return CanvasRect(static_cast<unsigned int>(x1), static_cast<unsigned int>(y1), static_cast<unsigned int>(x2), static_cast<unsigned int>(y2));
+  }
+
+
+  // Get a constant reference to the existing raster.
+  inline const Field2D<RasterInfo>& CanvasRaster::GetRasterData() const
+  {
+    return data_;
+  }
+
+
+  // Underlying raster exposing.
+  inline Field2D<RasterInfo>& CanvasRaster::GetRasterData()
+  {
+    return data_;
+  }
+  
+
+  // Gets console width.
+  inline unsigned int CanvasRaster::GetRasterWidth() const
+  { 
+    return width_;
+  }  
+
+
+  // Get console height
+  inline unsigned int CanvasRaster::GetRasterHeight() const
+  { 
+    return height_;
+  } 
+
+
+    //////////////////////////
+   // Rectangles of cells  //
+  //////////////////////////
+  // Default constructor, an empty rectangle.
+  inline CanvasRect::CanvasRect() : X1(0), Y1(0), X2(0), Y2(0)
+  {  }
+
+
+  // Constructs from corners. The second corner is not part of the rectangle.
+  inline CanvasRect::CanvasRect(unsigned int x1, unsigned int y1, unsigned int x2, unsigned int y2)
+    : X1(x1), Y1(y1), X2(x2), Y2(y2)
+  {  }
+
+
+  // Returns if there are no cells in the rectangle.
+  inline bool CanvasRect::Empty() const
+  {
+    return X1 >= X2 || Y1 >= Y2;
+  }
+
+
+  // Returns if the cell is in the rectangle.
+  inline bool CanvasRect::Contains(unsigned int x, unsigned int y) const
+  {
+    return x >= X1 && x < X2 && y >= Y1 && y < Y2;
+  }
+
+
+  // Returns if any cell is in both rectangles.
+  inline bool CanvasRect::Overlaps(const CanvasRect &rhs) const
+  {
+    return !Empty() && !rhs.Empty() && X1 < rhs.X2 && rhs.X1 < X2 && Y1 < rhs.Y2 && rhs.Y1 < Y2;
+  }
+
+
+  // Grows to also cover another rectangle.
+  inline void CanvasRect::Merge(const CanvasRect &rhs)
+  {
+    if (rhs.Empty())
+      return;
+    if (Empty())
+    {
+      *this = rhs;
+      return;
+    }
+
+    if (rhs.X1 < X1) X1 = rhs.X1;
+    if (rhs.Y1 < Y1) Y1 = rhs.Y1;
+    if (rhs.X2 > X2) X2 = rhs.X2;
+    if (rhs.Y2 > Y2) Y2 = rhs.Y2;
+  }
+
+
+  // Shrinks to what is within an area of width by height at 0, 0.
+  inline void CanvasRect::Clip(unsigned int width, unsigned int height)
+  {
+    if (X2 > width) X2 = width;
+    if (Y2 > height) Y2 = height;
+    if (Empty())
+      *this = CanvasRect();
+  }
+
+
+    ////////////////////
+   // Canvas layers  //
+  ////////////////////
+  // Constructs an empty, visible and fully see-through layer.
+  inline CanvasLayer::CanvasLayer(const std::string &name, int z, unsigned int width, unsigned int height)
+    : Name(name)
+    , Z(z)
+    , Visible(true)
+    , Opaque()
+    , Dirty()
+    , Extent()
+    , Raster(width, height)
+  {
+    Raster.Zero();
+  }
+
+
+  // Notes the span of cells from begin up to end as drawn to. Spans covering more than a
+  // row are widened to full rows.
+  inline void CanvasLayer::Touch(unsigned int begin, unsigned int end)
+  {
+    const unsigned int width = Raster.GetRasterWidth();
+    const unsigned int length = width * Raster.GetRasterHeight();
+    if (end > length) end = length;
+    if (begin >= end)
+      return;
+
+    CanvasRect rect(0, begin / width, width, (end - 1) / width + 1);
+    if (rect.Y2 - rect.Y1 == 1)
+    {
+      rect.X1 = begin % width;
+      rect.X2 = (end - 1) % width + 1;
+    }
+
+    Dirty.Merge(rect);
+    Extent.Merge(rect);
+  }
+
+
+  // Removes everything drawn. What was drawn still needs compositing away.
+  inline void CanvasLayer::Clear()
+  {
+    Raster.Zero();
+    Dirty.Merge(Extent);
+    Extent = CanvasRect();
+  }
+}
+
+///////////////////////////////////////////////////////////////////////
+//Canvas.cpp
+///////////////////////////////////////////////////////////////////////
+#include <cstdio>           // PutC
+#include <iostream>         // ostream access
+#include <csignal>          // Signal termination and resizes.
+#include <chrono>           // Time related info for sleeping.
+#include <thread>           // Sleep on exit to allow for update to finish.
+#include <string>           // String for parsing.
+#include <cstring>          // strlen, memset, memcpy.
+#ifndef OS_WINDOWS
+  #include <poll.h>         // Checking input without blocking.
+#endif
+
+
+
+
+namespace RConsole
+{
+  //#define DEFAULT_WIDTH_SIZE (rlutil::tcols() - 1)
+  //#define DEFAULT_HEIGHT_SIZE rlutil::trows()
+
+  //// Static initialization in non-guaranteed order.
+  //CanvasRaster Canvas::r_         = CanvasRaster(DEFAULT_WIDTH_SIZE, DEFAULT_HEIGHT_SIZE);
+  //CanvasRaster Canvas::prev_      = CanvasRaster(DEFAULT_WIDTH_SIZE, DEFAULT_HEIGHT_SIZE);
+  //bool Canvas::hasLazyInit_       = false;
+  //bool Canvas::isDrawing_         = true;
+  //unsigned int Canvas::width_     = DEFAULT_WIDTH_SIZE;
+  //unsigned int Canvas::height_    = DEFAULT_HEIGHT_SIZE;
+  //Field2D<bool> Canvas::modified_ = Field2D<bool>(DEFAULT_WIDTH_SIZE, DEFAULT_HEIGHT_SIZE);
+
+
+    //////////////////////
+   // Band Pool Object //
+  //////////////////////
+  // Starts the threads, which wait for work.
+  inline BandPool::BandPool(size_t threads)
+    : workers_()
+    , mutex_()
+    , wake_()
+    , done_()
+    , job_(nullptr)
+    , next_(0)
+    , count_(0)
+    , finished_(0)
+    , running_(true)
+  {
+    workers_.reserve(threads);
+    for (size_t i = 0; i < threads; ++i)
+      workers_.emplace_back(&BandPool::work, this);
+  }
+
+
+  // Stops and joins the threads.
+  inline BandPool::~BandPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      running_ = false;
+    }
+    wake_.notify_all();
+    for (std::thread &worker : workers_)
+      worker.join();
+  }
+
+
+  // Gets how many threads help out, not counting the caller.
+  inline size_t BandPool::GetThreadCount() const
+  {
+    return workers_.size();
+  }
+
+
+  // Runs job once for each band from 0 up to count, and waits until they are all done.
+  inline void BandPool::Run(size_t count, const std::function<void(size_t)> &job)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    job_ = &job;
+    next_ = 0;
+    count_ = count;
+    finished_ = 0;
+    wake_.notify_all();
+
+    while (take(lock))
+      ;
+    done_.wait(lock, [this]() { return finished_ == count_; });
+    job_ = nullptr;
+  }
+
+
+  // Worker loop.
+  inline void BandPool::work()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;)
+    {
+      wake_.wait(lock, [this]() { return !running_ || (job_ != nullptr && next_ < count_); });
+      if (!running_)
+        return;
+      while (take(lock))
+        ;
+    }
+  }
+
+
+  // Runs the next band outside the lock, if there is one left.
+  inline bool BandPool::take(std::unique_lock<std::mutex> &lock)
+  {
+    if (job_ == nullptr || next_ >= count_)
+      return false;
+
+    const size_t band = next_++;
+    const std::function<void(size_t)> &job = *job_;
+    lock.unlock();
+    job(band);
+    lock.lock();
+
+    if (++finished_ == count_)
+      done_.notify_all();
+    return true;
+  }
+
+
+  // Constructs empty damage.
+  inline FrameDamage::FrameDamage()
+    : open_(0)
+  {  }
+
+
+  // Number of changed rectangles.
+  inline size_t FrameDamage::GetCount() const
+  {
+    return rects_.size();
+  }
+
+
+  // A changed rectangle, in cells.
+  inline const CanvasRect &FrameDamage::GetRect(size_t index) const
+  {
+    return rects_[index];
+  }
+
+
+  // The cells of a changed rectangle as they are now on screen, its width per row.
+  inline const RasterInfo *FrameDamage::GetCells(size_t index) const
+  {
+    return cells_.data() + offsets_[index];
+  }
+
+
+  // Empties the damage, keeping its storage.
+  inline void FrameDamage::Clear()
+  {
+    rects_.clear();
+    offsets_.clear();
+    cells_.clear();
+    open_ = 0;
+  }
+
+
+    /////////////////////////////
+   // Public Member Functions //
+  /////////////////////////////
+  // Constructs a terminal of the given size, writing to and reading from the descriptors.
+  inline Terminal::Terminal(unsigned int width, unsigned int height, int outputFd, int inputFd)
+    : r_(width, height)
+    , prev_(width, height)
+    , isDrawing_(true)
+    , width_(width)
+    , height_(height)
+    , modified_(width, height)
+    , isRetained_(false)
+    , dirtyBegin_(0)
+    , dirtyEnd_(0)
+    , layers_()
+    , layer_(nullptr)
+    , base_(nullptr)
+    , damage_()
+    , fdSink_(outputFd)
+    , sink_(&fdSink_)
+    , inputFd_(inputFd)
+    , isConsole_(false)
+    , out_()
+    , depth_(Palette::DetectDepth())
+    , pen_()
+    , bands_()
+    , bandOut_()
+    , bandPen_()
+  {
+    #if defined(OS_WINDOWS) && !defined(RLUTIL_USE_ANSI)
+    isConsole_ = (outputFd == 1);
+    #endif
+  }
+
+
+  // Destructor, frees the layers.
+  inline Terminal::~Terminal()
+  {
+    for (CanvasLayer *layer : layers_)
+      delete layer;
+  }
+
+
+  // Setup with width and height. Can be re-init
+  inline void Terminal::ReInit(unsigned int width, unsigned int height)
+  {
+    width_ = width;
+    height_ = height;
+    r_.Resize(width, height);
+    prev_.Resize(width, height);
+    modified_.Resize(width, height);
+    dirtyBegin_ = width * height;
+    dirtyEnd_ = 0;
+
+    // Layers keep their place, but not what was drawn to them.
+    for (CanvasLayer *layer : layers_)
+    {
+      layer->Raster.Resize(width, height);
+      layer->Raster.Zero();
+      layer->Opaque = CanvasRect();
+      layer->Dirty = CanvasRect();
+      layer->Extent = CanvasRect();
+    }
+    damage_.clear();
+  }
+
+
+  // Resizes keeping whatever is in the area both sizes share, in the rasters and in every
+  // layer. The terminal keeps showing those cells as well, so the next update only writes
+  // what it newly exposed and anything drawn since the last one, rather than everything.
+  inline void Terminal::Resize(unsigned int width, unsigned int height)
+  {
+    if (width == width_ && height == height_)
+      return;
+
+    // The screen raster is unknown where it is new, so it always differs.
+    r_.Reshape(width, height, isRetained_ ? RasterInfo(' ', WHITE) : RasterInfo());
+    prev_.Reshape(width, height, RasterInfo());
+    for (CanvasLayer *layer : layers_)
+    {
+      layer->Raster.Reshape(width, height, RasterInfo());
+      layer->Opaque.Clip(width, height);
+      layer->Dirty.Clip(width, height);
+      layer->Extent.Clip(width, height);
+    }
+    width_ = width;
+    height_ = height;
+
+    // Cells drawn to but not yet written were tracked at the old size, so look again.
+    modified_.Resize(width, height);
+    dirtyBegin_ = width * height;
+    dirtyEnd_ = 0;
+    const RasterInfo *currs = r_.GetRasterData().begin();
+    const RasterInfo *prevs = prev_.GetRasterData().begin();
+    for (unsigned int index = 0; index < width * height; ++index)
+    {
+      if (currs[index] != prevs[index] && (isRetained_ || currs[index].Value != 0))
+      {
+        modified_.Set(index);
+        markDirty(index, index + 1);
+      }
+    }
+  }
+
+
+  // Clear out the screen that the user sees.
+  // Note: More expensive than clearing just the previous spaces
+  // but less expensive than clearing entire buffer with command.
+  inline void Terminal::FillCanvas(const RasterInfo &ri)
+  {
+    touch(0, width_ * height_);
+    target().Fill(ri);
+  }
+
+  // Write the specific character in a specific color to a specific location on the console.
+  inline void Terminal::Draw(char32_t toWrite, float x, float y, CellColor color, CellColor background)
+  {
+    #ifdef RConsole_CLIP_CONSOLE
+
+    if (x >= width_) return;
+    if (y >= height_) return;
+		if (x <= 0) return;
+		if (y <= 0) return;
+
+    #endif // RConsole_CLIP_CONSOLE
+
+    touch(target().WriteChar(toWrite, x, y, color, background));
+  }
+
+
+  // Draw a string
+  inline void Terminal::DrawString(const char* toDraw, float xStart, float yStart, CellColor color, CellColor background)
+  {
+    DrawString(toDraw, strlen(toDraw), xStart, yStart, color, background);
+  }
+
+
+  // Draw a string of known length. It does not need to be null terminated.
+  inline void Terminal::DrawString(const char* toDraw, size_t len, float xStart, float yStart, CellColor color, CellColor background)
+  {
+	  if (len <= 0) return;
+
+    #ifdef RConsole_CLIP_CONSOLE
+
+    // Bounds check.
+    if (xStart >= width_) return;
+    if (yStart >= height_) return;
+
+    #endif
+
+	  // Write string, and set the memory it took up to modified.
+	  touch(target().WriteString(toDraw, len, xStart, yStart, color, background));
+  }
+
+  // Draws the written cells of a canvas sized raster within an area. Zeroed cells are
+  // skipped, so whatever is already on the canvas shows through them.
+  inline void Terminal::DrawRaster(const CanvasRaster &raster, unsigned int x, unsigned int y, unsigned int width, unsigned int height)
+  {
+    if (raster.GetRasterWidth() != width_ || raster.GetRasterHeight() != height_)
+      return;
+
+    const unsigned int xEnd = (x + width < width_) ? x + width : width_;
+    const unsigned int yEnd = (y + height < height_) ? y + height : height_;
+    if (x >= xEnd)
+      return;
+
+    const Field2D<RasterInfo> &src = raster.GetRasterData();
+    RasterInfo *dst = target().GetRasterData().GetHead();
+    for (unsigned int row = y; row < yEnd; ++row)
+    {
+      const unsigned int begin = row * width_ + x;
+      const unsigned int end = row * width_ + xEnd;
+      for (unsigned int index = begin; index < end; ++index)
+      {
+        const RasterInfo &ri = src.Peek(index);
+        if (ri.Value == 0)
+          continue;
+
+        dst[index] = ri;
+        if (layer_ == nullptr)
+          modified_.Set(index);
+      }
+
+      if (layer_ != nullptr)
+        layer_->Touch(begin, end);
+      else
+        markDirty(begin, end);
+    }
+  }
+
+  // Draws the canvas sized view of a larger tiled field whose top left is at viewX, viewY.
+  // Like DrawRaster, zeroed cells show through, and so do tiles that were never written
+  // to, which are skipped outright so only the visible written tiles cost anything.
+  inline void Terminal::DrawTiled(const TiledField2D<RasterInfo> &field, unsigned int viewX, unsigned int viewY)
+  {
+    const unsigned int tile = TiledField2D<RasterInfo>::Size;
+    if (viewX >= field.Width() || viewY >= field.Height())
+      return;
+
+    const unsigned int viewW = std::min(width_, field.Width() - viewX);
+    const unsigned int viewH = std::min(height_, field.Height() - viewY);
+    RasterInfo *dst = target().GetRasterData().GetHead();
+    for (unsigned int ty = viewY / tile; ty <= (viewY + viewH - 1) / tile; ++ty)
+    {
+      for (unsigned int tx = viewX / tile; tx <= (viewX + viewW - 1) / tile; ++tx)
+      {
+        const RasterInfo *cells = field.GetTile(tx, ty);
+        if (cells == nullptr)
+          continue;
+
+        // Part of this tile inside the view, in field coordinates.
+        const unsigned int xBegin = std::max(tx * tile, viewX);
+        const unsigned int xEnd = std::min((tx + 1) * tile, viewX + viewW);
+        const unsigned int yBegin = std::max(ty * tile, viewY);
+        const unsigned int yEnd = std::min((ty + 1) * tile, viewY + viewH);
+        for (unsigned int y = yBegin; y < yEnd; ++y)
+        {
+          const RasterInfo *src = cells + (y - ty * tile) * tile;
+          const unsigned int begin = (y - viewY) * width_ + (xBegin - viewX);
+          const unsigned int end = begin + (xEnd - xBegin);
+          unsigned int index = begin;
+          for (unsigned int x = xBegin; x < xEnd; ++x, ++index)
+          {
+            const RasterInfo &ri = src[x - tx * tile];
+            if (ri.Value == 0)
+              continue;
+
+            dst[index] = ri;
+            if (layer_ == nullptr)
+              modified_.Set(index);
+          }
+
+          if (layer_ != nullptr)
+            layer_->Touch(begin, end);
+          else
+            markDirty(begin, end);
+        }
+      }
+    }
+  }
+
+  // Updates the current raster by drawing it to the screen, filling damage with what
+  // changed if it was given.
+  inline bool Terminal::Update(FrameDamage *damage)
+  {
+    if (damage != nullptr)
+      damage->Clear();
+    if (!isDrawing_) return false;
+
+    if (layers_.size() > 0)
+      composite();
+
+    // Exported before encoding, while the previous raster still has the old screen.
+    if (damage != nullptr)
+      exportDamage(*damage);
+
+    if (isRetained_)
+    {
+      encode(dirtyBegin_, dirtyEnd_);
+      modified_.ResetRange(dirtyBegin_, dirtyEnd_);
+      dirtyBegin_ = width_ * height_;
+      dirtyEnd_ = 0;
+    }
+    else
+    {
+      encode(0, width_ * height_);
+      modified_.Zero();
+    
+      // Write and reset the raster. The base layer stands in for it, so it goes too.
+      memcpy(prev_.GetRasterData().GetHead(), r_.GetRasterData().GetHead(), width_ * height_ * sizeof(RasterInfo));
+      r_.Zero();
+      if (base_ != nullptr)
+      {
+        base_->Clear();
+        base_->Dirty = CanvasRect();
+      }
+    }
+
+    setColor(out_, pen_, WHITE, CellColor());
+    flush();
+
+    return true;
+  }
+
+
+  // Updates the default terminal, setting up the close handler the first time.
+  inline bool Canvas::Update(FrameDamage *damage)
+  {
+    if (!hasLazyInit_)
+    {
+      setCloseHandler();
+      setResizeHandler();
+      hasLazyInit_ = true;
+    }
+
+    return terminal_.Update(damage);
+  }
+
+
+  // Draws a point with ASCII to attempt to represent alpha values in 4 steps.
+  inline void Terminal::DrawAlpha(float x, float y, CellColor color, float opacity)
+  {
+    // Shade block elements, which were alt-codes back when output was CP437.
+    if (opacity < .25)
+      Draw(char32_t(0x2591), x, y, color);
+    else if (opacity < .5)
+      Draw(char32_t(0x2592), x, y, color);
+    else if (opacity < .75)
+      Draw(char32_t(0x2593), x, y, color);
+    else
+      Draw(char32_t(0x2588), x, y, color);
+  }
+
+
+  // Stops the update loop.
+  inline void Terminal::Shutdown()
+  {
+    isDrawing_ = false;
+  }
+
+
+  // Draws a point with ASCII to attempt to represent location in a square.
+  inline void Terminal::DrawPartialPoint(float x, float y, CellColor color)
+  {
+    // Get first two decimal places from location.
+    int xDec = static_cast<int>(x * 100) % 100;
+    int yDec = static_cast<int>(x * 100) % 100;
+
+
+    UNUSED(xDec);
+    UNUSED(yDec);
+
+
+    //If Y is closer to a border, use it for placement.
+    if (RFuncs::Abs(50 - static_cast<int>(x)) < RFuncs::Abs(50 - static_cast<int>(y)))
+    {
+      if (x > 50)
+        return Draw(char32_t(0x2590), x, y, color);
+      return Draw(char32_t(0x258C), x, y, color);
+    }
+    //Otherwise, X is closer to a border.
+    else
+    {
+      if (y > 50)
+        return Draw(char32_t(0x2580), x, y, color);
+      return Draw(char32_t(0x2584), x, y, color);
+    }
+  }
+
+  // Drawing box, filled from x1, y1 up to but not including x2, y2.
+  inline void Terminal::DrawBox(char32_t toWrite, float x1, float y1, float x2, float y2, CellColor color)
+  {
+    if (x1 > x2)
+      std::swap(x1, x2);
+    if (y1 > y2)
+      std::swap(y1, y2);
+
+    // At this point it can be assumed that x1 and y1 and lower than x2 and y2 respectively.
+    const int x = static_cast<int>(x1);
+    const int y = static_cast<int>(y1);
+    FillRect(RasterInfo(toWrite, color), x, y, static_cast<unsigned int>(static_cast<int>(x2) - x), static_cast<unsigned int>(static_cast<int>(y2) - y));
+  }
+
+
+  // Copies a block of cells with its top left at X, Y, clipped to the canvas.
+  inline void Terminal::Blit(const Field2D<RasterInfo> &cells, int x, int y)
+  {
+    touch(target().Blit(cells, x, y));
+  }
+
+
+  // Fills a rectangle with a cell, clipped to the canvas.
+  inline void Terminal::FillRect(const RasterInfo &ri, int x, int y, unsigned int width, unsigned int height)
+  {
+    touch(target().FillRect(ri, x, y, width, height));
+  }
+
+
+  // Clears the screen and forgets what was on it, so the next update draws everything.
+  // Useful when output starts going somewhere new, like a freshly connected session.
+  inline void Terminal::ClearScreen()
+  {
+    pen_ = Pen();
+    fullClear();
+    prev_.Zero();
+    modified_.Fill();
+    markDirty(0, width_ * height_);
+    flush();
+  }
+
+
+  //Set visibility of cursor to specified bool.
+  inline void Terminal::SetCursorVisible(bool isVisible)
+  {
+    #if defined(OS_WINDOWS) && !defined(RLUTIL_USE_ANSI)
+    if (isConsole_)
+    {
+      if (!isVisible)
+        rlutil::hidecursor();
+      else
+        rlutil::showcursor();
+      return;
+    }
+    #endif
+
+    out_ += isVisible ? "\033[?25h" : "\033[?25l";
+    flush();
+  }
+
+
+  // Adds an empty layer. Drawing keeps going to the current layer until SetLayer.
+  inline void Terminal::CreateLayer(const std::string &name, int z)
+  {
+    if (findLayer(name) != nullptr)
+      return;
+
+    // The first layer brings in the base layer, holding what was drawn so far.
+    if (layers_.size() == 0)
+    {
+      base_ = new CanvasLayer("", 0, width_, height_);
+      base_->Raster.CopyFrom(r_);
+      base_->Touch(0, width_ * height_);
+      layers_.push_back(base_);
+      layer_ = base_;
+      if (name.empty())
+        return;
+    }
+
+    // Goes above every layer with the same Z.
+    size_t pos = 0;
+    while (pos < layers_.size() && layers_[pos]->Z <= z)
+      ++pos;
+
+    layers_.insert(layers_.begin() + pos, new CanvasLayer(name, z, width_, height_));
+    for (Damage &d : damage_)
+      if (d.Above >= pos)
+        ++d.Above;
+  }
+
+
+  // Removes a layer and what was drawn to it. The base layer stays.
+  inline void Terminal::RemoveLayer(const std::string &name)
+  {
+    if (name.empty())
+      return;
+
+    for (size_t i = 0; i < layers_.size(); ++i)
+    {
+      CanvasLayer *layer = layers_[i];
+      if (layer->Name != name)
+        continue;
+
+      // Whatever it covered has to be composited again from the layers left.
+      if (layer->Visible)
+      {
+        Damage d = { layer->Extent, i };
+        d.Area.Merge(layer->Opaque);
+        damage_.push_back(d);
+      }
+
+      for (Damage &d : damage_)
+        if (d.Above > i)
+          --d.Above;
+
+      if (layer_ == layer)
+        layer_ = base_;
+      layers_.erase(layers_.begin() + i);
+      delete layer;
+      return;
+    }
+  }
+
+
+  // Picks the layer drawing goes to. The empty name is the base layer.
+  inline void Terminal::SetLayer(const std::string &name)
+  {
+    CanvasLayer *layer = findLayer(name);
+    if (layer != nullptr)
+      layer_ = layer;
+  }
+
+
+  // Hides or shows a layer, keeping what was drawn to it.
+  inline void Terminal::SetLayerVisible(const std::string &name, bool isVisible)
+  {
+    for (size_t i = 0; i < layers_.size(); ++i)
+    {
+      CanvasLayer &layer = *layers_[i];
+      if (layer.Name != name || layer.Visible == isVisible)
+        continue;
+
+      // Showing is composited like any other change, hiding uncovers what is below.
+      layer.Visible = isVisible;
+      Damage d = { layer.Extent, isVisible ? i + 1 : i };
+      d.Area.Merge(layer.Opaque);
+      damage_.push_back(d);
+      return;
+    }
+  }
+
+
+  // Sets the area of a layer that hides everything under it, drawn to or not. Popups and
+  // bars over large menus use this so nothing beneath them is composited.
+  inline void Terminal::SetLayerOpaque(const std::string &name, unsigned int x, unsigned int y, unsigned int width, unsigned int height)
+  {
+    CanvasLayer *layer = findLayer(name);
+    if (layer == nullptr)
+      return;
+
+    layer->Dirty.Merge(layer->Opaque);
+    layer->Opaque = CanvasRect(x, y, x + width, y + height);
+    layer->Dirty.Merge(layer->Opaque);
+  }
+
+
+  // Removes everything drawn to a layer.
+  inline void Terminal::ClearLayer(const std::string &name)
+  {
+    CanvasLayer *layer = findLayer(name);
+    if (layer != nullptr)
+      layer->Clear();
+  }
+
+
+  // Retained mode keeps everything drawn until it is drawn over, instead of clearing
+  // whatever wasn't drawn again before each update. Only cells drawn to since the last
+  // update are compared and written, so an update with nothing drawn costs nothing.
+  // Erase by drawing spaces.
+  inline void Terminal::SetRetained(bool isRetained)
+  {
+    if (isRetained == isRetained_)
+      return;
+
+    // The raster has to start out matching what is on screen.
+    if (isRetained)
+      memcpy(r_.GetRasterData().GetHead(), prev_.GetRasterData().GetHead(), width_ * height_ * sizeof(RasterInfo));
+    else
+      r_.Zero();
 
-  // Get console height
-  inline unsigned int CanvasRaster::GetRasterHeight() const
-  { 
-    return height_;
-  } 
-}
+    modified_.Zero();
+    dirtyBegin_ = width_ * height_;
+    dirtyEnd_ = 0;
+    isRetained_ = isRetained;
+  }
 
-///////////////////////////////////////////////////////////////////////
-//Canvas.cpp
-///////////////////////////////////////////////////////////////////////
-#include <cstdio>           // PutC
-#include <iostream>         // ostream access
-#include <csignal>          // Signal termination.
-#include <chrono>           // Time related info for sleeping.
-#include <thread>           // Sleep on exit to allow for update to finish.
-#include <string>           // String for parsing.
 
+  // Encodes big updates in bands of rows on this many threads, counting the one calling
+  // Update. 0 or 1 encodes everything on the calling thread.
+  inline void Terminal::SetBands(unsigned int threads)
+  {
+    if (threads <= 1)
+      bands_.reset();
+    else if (bands_ == nullptr || bands_->GetThreadCount() != threads - 1)
+      bands_.reset(new BandPool(threads - 1));
+  }
 
 
+  // Sets how many colors output can show. Anything richer is brought down to the nearest
+  // color at that depth when written. Starts out guessed from the environment.
+  inline void Terminal::SetColorDepth(ColorDepth depth)
+  {
+    depth_ = depth;
+  }
 
-namespace RConsole
-{
-  //#define DEFAULT_WIDTH_SIZE (rlutil::tcols() - 1)
-  //#define DEFAULT_HEIGHT_SIZE rlutil::trows()
 
-  //// Static initialization in non-guaranteed order.
-  //CanvasRaster Canvas::r_         = CanvasRaster(DEFAULT_WIDTH_SIZE, DEFAULT_HEIGHT_SIZE);
-  //CanvasRaster Canvas::prev_      = CanvasRaster(DEFAULT_WIDTH_SIZE, DEFAULT_HEIGHT_SIZE);
-  //bool Canvas::hasLazyInit_       = false;
-  //bool Canvas::isDrawing_         = true;
-  //unsigned int Canvas::width_     = DEFAULT_WIDTH_SIZE;
-  //unsigned int Canvas::height_    = DEFAULT_HEIGHT_SIZE;
-  //Field2D<bool> Canvas::modified_ = Field2D<bool>(DEFAULT_WIDTH_SIZE, DEFAULT_HEIGHT_SIZE);
+  // Sends output to a sink instead of the output descriptor, such as memory for rendering
+  // headless. The sink isn't owned, and has to outlive the terminal or be unset first.
+  // Null goes back to the descriptor.
+  inline void Terminal::SetSink(OutputSink *sink)
+  {
+    sink_ = (sink != nullptr) ? sink : &fdSink_;
 
+    #if defined(OS_WINDOWS) && !defined(RLUTIL_USE_ANSI)
+    isConsole_ = (sink_ == &fdSink_ && fdSink_.GetFd() == 1);
+    #endif
+  }
 
-    /////////////////////////////
-   // Public Member Functions //
-  /////////////////////////////
-  // Setup with width and height. Can be re-init
-  inline void Canvas::ReInit(unsigned int width, unsigned int height)
+
+  // Reads whatever input is waiting, without blocking.
+  inline int Terminal::Read(char *buffer, size_t size)
   {
-    width_ = width;
-    height_ = height;
-    r_ = CanvasRaster(width, height);
-    prev_ = CanvasRaster(width, height);
-    modified_ = Field2D<bool>(width, height);
+    #ifdef OS_WINDOWS
+    UNUSED(buffer);
+    UNUSED(size);
+    return 0;
+    #else
+    struct pollfd pfd = { inputFd_, POLLIN, 0 };
+    if (poll(&pfd, 1, 0) <= 0)
+      return 0;
+
+    const ssize_t count = read(inputFd_, buffer, size);
+    if (count <= 0)
+      return -1;
+    return static_cast<int>(count);
+    #endif
   }
 
 
-  // Clear out the screen that the user sees.
-  // Note: More expensive than clearing just the previous spaces
-  // but less expensive than clearing entire buffer with command.
-  inline void Canvas::FillCanvas(const RasterInfo &ri)
+  // Gets the width of the console
+  inline unsigned int Terminal::GetConsoleWidht() const
   {
-    r_.Fill(ri);
+    return width_;
   }
 
-  // Write the specific character in a specific color to a specific location on the console.
-  inline void Canvas::Draw(char toWrite, float x, float y, Color color)
+
+  // Gets the height of the console
+  inline unsigned int Terminal::GetConsoleHeight() const
   {
-    #ifdef RConsole_CLIP_CONSOLE
+    return height_;
+  }
 
-    if (x >= width_) return;
-    if (y >= height_) return;
-		if (x <= 0) return;
-		if (y <= 0) return;
 
-    #endif // RConsole_CLIP_CONSOLE
+  // Gets how many colors output is written with.
+  inline ColorDepth Terminal::GetColorDepth() const
+  {
+    return depth_;
+  }
+
 
-    modified_.GoTo(static_cast<int>(x), static_cast<int>(y));
-    modified_.Set(true);
-    r_.WriteChar(toWrite, x, y, color);
+  // Gets the sink output is written to.
+  inline OutputSink *Terminal::GetSink() const
+  {
+    return sink_;
   }
 
 
-  // Draw a string
-  inline void Canvas::DrawString(const char* toDraw, float xStart, float yStart, Color color)
+  // Gets the descriptor output is written to when no other sink was set.
+  inline int Terminal::GetOutputFd() const
   {
-	  size_t len = strlen(toDraw);
-	  if (len <= 0) return;
+    return fdSink_.GetFd();
+  }
 
-    #ifdef RConsole_CLIP_CONSOLE
 
-    // Bounds check.
-    if (xStart > width_) return;
-    if (yStart > height_) return;
+  // Gets the descriptor input is read from.
+  inline int Terminal::GetInputFd() const
+  {
+    return inputFd_;
+  }
 
-	  // Set the memory we are using to modified.
-	  modified_.GoTo(static_cast<int>(xStart), static_cast<int>(yStart));
-	  unsigned int index = modified_.GetIndex();
-    if (xStart > width_) return;
+    //////////////////////////////
+   // Private Member Functions //
+  //////////////////////////////
+  // Clears out the screen based on the previous items written. Clear character is a space,
+  // on the default background. Only looks from begin up to end.
+  inline void Terminal::clearPrevious(std::string &out, Pen &pen, unsigned int begin, unsigned int end)
+  {
+    // Walk through, write over only what was modified.
+    const RasterInfo *currs = r_.GetRasterData().begin();
+    const RasterInfo *prevs = prev_.GetRasterData().begin();
+    for (unsigned int index = modified_.NextUnset(begin); index < end; index = modified_.NextUnset(index + 1))
+    {
+      // If we have not modified the space,
+      // and we don't have the same character as last time,
+      // and we don't have the same color.
+      if (currs[index] != prevs[index])
+      {
+        // Compute X and Y location
+        unsigned int xLoc = (index % width_) + 1;
+        unsigned int yLoc = (index / width_) + 1;
 
-    // Checks the length and adjusts if it will be past.
-    int writeLen = static_cast<int>(len);
-    if (writeLen + index > modified_.Length())
-      writeLen = modified_.Length() - index;
+        // locate on screen and set color
+        locate(out, xLoc, yLoc);
+        setColor(out, pen, WHITE, CellColor());
 
-    // If our length plus the index we are at exceeds the end of the buffer,
-    memset(modified_.GetHead() + index, true, writeLen);
+        putC(out, ' ');
+      }
+    }
+  }
 
-    #else
 
-    // Just blindly set modified for the length.
-    modified_.GoTo(static_cast<int>(xStart), static_cast<int>(yStart));
-    unsigned int index = modified_.GetIndex();
-	  memset(modified_.GetHead() + index, true, len);
+  // Writes cells from begin up to end that were drawn to and differ from the screen. The
+  // first one written always moves the cursor, so bands join up.
+  inline void Terminal::writeRetained(std::string &out, Pen &pen, unsigned int begin, unsigned int end)
+  {
+    Field2D<RasterInfo> &curr = r_.GetRasterData();
+    Field2D<RasterInfo> &prev = prev_.GetRasterData();
+    unsigned int cursor = width_ * height_;
+    for (unsigned int index = modified_.NextSet(begin); index < end; index = modified_.NextSet(index + 1))
+    {
+      const RasterInfo &ri = curr.Peek(index);
+      if (ri == prev.Peek(index))
+        continue;
+
+      // The right half of a wide character is drawn along with its left half.
+      prev.GetHead()[index] = ri;
+      if (ri.Value == Unicode::Continuation)
+        continue;
+
+      // Consecutive cells on a row don't need the cursor moved.
+      if (index != cursor || index % width_ == 0)
+        locate(out, (index % width_) + 1, (index / width_) + 1);
+      setColor(out, pen, ri.C, ri.Bg);
+      putC(out, ri.Value);
+      cursor = index + ((Unicode::Width(ri.Value) == 2) ? 2 : 1);
+    }
+  }
 
-    #endif
 
+  // Encodes the cells from begin up to end into the output. Big enough spans are split
+  // into bands of whole rows encoded on the band threads, then joined in order. Bands
+  // after the first can't know the colors the one before left off in, so they start from
+  // an unknown pen. The Windows console is written to directly, so it always goes one
+  // cell at a time.
+  inline void Terminal::encode(unsigned int begin, unsigned int end)
+  {
+    if (begin >= end)
+      return;
+
+    const unsigned int firstRow = begin / width_;
+    const unsigned int rows = (end - 1) / width_ + 1 - firstRow;
+    size_t count = 1;
+    if (bands_ != nullptr && !isConsole_ && end - begin >= BandMinimum)
+      count = std::min<size_t>(bands_->GetThreadCount() + 1, rows);
+    if (count <= 1)
+    {
+      encodeBand(out_, pen_, begin, end);
+      return;
+    }
 
-	  // Write string
-	  r_.WriteString(toDraw, len, xStart, yStart, color);
+    if (bandOut_.size() < count)
+    {
+      bandOut_.resize(count);
+      bandPen_.resize(count);
+    }
+    const std::function<void(size_t)> job = [&](size_t band)
+    {
+      const unsigned int bandBegin = std::max(begin, static_cast<unsigned int>(firstRow + rows * band / count) * width_);
+      const unsigned int bandEnd = std::min(end, static_cast<unsigned int>(firstRow + rows * (band + 1) / count) * width_);
+      bandOut_[band].clear();
+      bandPen_[band] = (band == 0) ? pen_ : Pen();
+      encodeBand(bandOut_[band], bandPen_[band], bandBegin, bandEnd);
+    };
+    bands_->Run(count, job);
+
+    // The pen ends up wherever the last band to set a color left it.
+    for (size_t band = 0; band < count; ++band)
+    {
+      out_ += bandOut_[band];
+      if (bandPen_[band].Known)
+        pen_ = bandPen_[band];
+    }
   }
 
-  // Updates the current raster by drawing it to the screen.
-  inline bool Canvas::Update()
+
+  // Encodes one band. Bands only write the cells of their own rows back to the screen
+  // raster, so they can run at the same time.
+  inline void Terminal::encodeBand(std::string &out, Pen &pen, unsigned int begin, unsigned int end)
   {
-    if (!isDrawing_) return false;
-    
-    if (!hasLazyInit_)
+    if (isRetained_)
+      writeRetained(out, pen, begin, end);
+    else
     {
-      setCloseHandler();
-      hasLazyInit_ = true;
+      clearPrevious(out, pen, begin, end);
+      writeRaster(r_, out, pen, begin, end);
     }
+  }
 
-    clearPrevious();
-    writeRaster(r_);
-    
-    // Write and reset the raster.
-    memcpy(prev_.GetRasterData().GetHead(), r_.GetRasterData().GetHead(), width_ * height_ * sizeof(RasterInfo));
-    r_.Zero();
 
-    rlutil::setColor(WHITE);
+  // Notes cells as drawn to, on the current layer if there is one.
+  inline void Terminal::touch(unsigned int begin, unsigned int end)
+  {
+    if (layer_ != nullptr)
+    {
+      layer_->Touch(begin, end);
+      return;
+    }
 
-    return true;
+    modified_.SetRange(begin, end);
+    markDirty(begin, end);
   }
 
 
-  // Draws a point with ASCII to attempt to represent alpha values in 4 steps.
-  inline void Canvas::DrawAlpha(float x, float y, Color color, float opacity)
+  // Notes a rectangle as drawn to, a row at a time.
+  inline void Terminal::touch(const CanvasRect &area)
   {
-    // All characters use represent alt-codes. 
-    if (opacity < .25)
-      Draw(static_cast<unsigned char>(176), x, y, color);
-    else if (opacity < .5)
-      Draw(static_cast<unsigned char>(177), x, y, color);
-    else if (opacity < .75)
-      Draw(static_cast<unsigned char>(178), x, y, color);
-    else
-      Draw(static_cast<unsigned char>(219), x, y, color);
+    for (unsigned int row = area.Y1; row < area.Y2; ++row)
+      touch(row * width_ + area.X1, row * width_ + area.X2);
   }
 
 
-  // Stops the update loop.
-  inline void Canvas::Shutdown()
+  // The raster drawing goes to.
+  inline CanvasRaster &Terminal::target()
   {
-    isDrawing_ = false;
+    if (layer_ != nullptr)
+      return layer_->Raster;
+    return r_;
   }
 
 
-  // Draws a point with ASCII to attempt to represent location in a square.
-  inline void Canvas::DrawPartialPoint(float x, float y, Color color)
+  // Finds a layer by name, or null.
+  inline CanvasLayer *Terminal::findLayer(const std::string &name)
   {
-    // Get first two decimal places from location.
-    int xDec = static_cast<int>(x * 100) % 100;
-    int yDec = static_cast<int>(x * 100) % 100;
+    for (CanvasLayer *layer : layers_)
+      if (layer->Name == name)
+        return layer;
+    return nullptr;
+  }
 
 
-    UNUSED(xDec);
-    UNUSED(yDec);
+  // Composites what changed on the layers since the last update into the raster. Without
+  // retained mode the raster starts out empty every update, so all of every layer is needed.
+  inline void Terminal::composite()
+  {
+    for (size_t i = 0; i < layers_.size(); ++i)
+    {
+      CanvasLayer &layer = *layers_[i];
+      CanvasRect area = layer.Dirty;
+      if (!isRetained_)
+      {
+        area = layer.Extent;
+        area.Merge(layer.Opaque);
+      }
 
+      layer.Dirty = CanvasRect();
+      if (!layer.Visible || area.Empty())
+        continue;
 
-    //If Y is closer to a border, use it for placement.
-    if (RFuncs::Abs(50 - static_cast<int>(x)) < RFuncs::Abs(50 - static_cast<int>(y)))
+      Damage d = { area, i + 1 };
+      damage_.push_back(d);
+    }
+
+    // Overlapping areas are merged, so no cell is resolved twice.
+    bool merged = true;
+    while (merged)
     {
-      if (x > 50)
-        return Draw(static_cast<unsigned char>(222), x, y, color);
-      return Draw(static_cast<unsigned char>(221), x, y, color);
+      merged = false;
+      for (size_t i = 0; i < damage_.size() && !merged; ++i)
+        for (size_t j = i + 1; j < damage_.size() && !merged; ++j)
+          if (damage_[i].Area.Overlaps(damage_[j].Area))
+          {
+            damage_[i].Area.Merge(damage_[j].Area);
+            if (damage_[j].Above < damage_[i].Above)
+              damage_[i].Above = damage_[j].Above;
+            damage_.erase(damage_.begin() + j);
+            merged = true;
+          }
     }
-    //Otherwise, X is closer to a border.
-    else
+
+    RasterInfo *out = r_.GetRasterData().GetHead();
+    for (const Damage &d : damage_)
     {
-      if (y > 50)
-        return Draw(static_cast<unsigned char>(223), x, y, color);
-      return Draw(static_cast<unsigned char>(220), x, y, color);
+      const unsigned int x2 = (d.Area.X2 < width_) ? d.Area.X2 : width_;
+      const unsigned int y2 = (d.Area.Y2 < height_) ? d.Area.Y2 : height_;
+      for (unsigned int y = d.Area.Y1; y < y2; ++y)
+      {
+        for (unsigned int x = d.Area.X1; x < x2; ++x)
+        {
+          // The raster is kept in retained mode, so cells under an opaque layer above
+          // everything that changed are already right.
+          if (isRetained_)
+          {
+            const unsigned int until = occludedUntil(x, y, d.Above);
+            if (until > x)
+            {
+              x = until - 1;
+              continue;
+            }
+          }
+
+          // Nothing on any layer is erased with a space, or just left out when the raster
+          // starts out empty anyway.
+          RasterInfo ri = resolve(x, y);
+          if (ri.Value == 0)
+          {
+            if (!isRetained_)
+              continue;
+            ri = RasterInfo(' ', WHITE);
+          }
+
+          const unsigned int index = y * width_ + x;
+          out[index] = ri;
+          modified_.Set(index);
+          markDirty(index, index + 1);
+        }
+      }
     }
+
+    damage_.clear();
   }
 
-  // Drawing box
-  inline void Canvas::DrawBox(char toWrite, float x1, float y1, float x2, float y2, Color color)
+
+  // Gets how far along the row the cell is hidden by opaque layers from the given one up.
+  // Returns x itself when it isn't hidden.
+  inline unsigned int Terminal::occludedUntil(unsigned int x, unsigned int y, size_t above) const
   {
-    
-    if(x1 > x2)
+    unsigned int until = x;
+    for (size_t i = above; i < layers_.size(); ++i)
     {
-      float temp = x1;
-      x2 = x1;
-      temp = x2;
+      const CanvasLayer &layer = *layers_[i];
+      if (layer.Visible && layer.Opaque.Contains(x, y) && layer.Opaque.X2 > until)
+        until = layer.Opaque.X2;
     }
-    if(y1 > y2)
+
+    return until;
+  }
+
+
+  // Gets what shows through all layers at a cell, looking down from the top.
+  inline RasterInfo Terminal::resolve(unsigned int x, unsigned int y) const
+  {
+    const unsigned int index = y * width_ + x;
+    for (size_t i = layers_.size(); i-- > 0;)
     {
-      float temp = y1;
-      y2 = y1;
-      temp = y2;
+      const CanvasLayer &layer = *layers_[i];
+      if (!layer.Visible)
+        continue;
+
+      const RasterInfo &ri = layer.Raster.GetRasterData().Peek(index);
+      if (ri.Value != 0)
+        return ri;
+      if (layer.Opaque.Contains(x, y))
+        return RasterInfo(' ', WHITE);
     }
 
-    // At this point it can be assumed that x1 and y1 and lower than x2 and y2 respectively.
+    return RasterInfo();
+  }
 
-    for(unsigned int x = static_cast<unsigned int>(x1); x < x2; ++x)
+
+  // Collects the cells whose shown value differs from the previous update, a run per row
+  // at a time, then copies what the rectangles cover.
+  inline void Terminal::exportDamage(FrameDamage &damage)
+  {
+    const RasterInfo *curr = r_.GetRasterData().GetHead();
+    const RasterInfo *prev = prev_.GetRasterData().GetHead();
+
+    // Retained mode only changes drawn cells, while immediate mode also blanks what
+    // was drawn last time and not this time.
+    unsigned int index = isRetained_ ? modified_.NextSet(dirtyBegin_) : 0;
+    const unsigned int end = isRetained_ ? dirtyEnd_ : width_ * height_;
+    unsigned int row = 0;
+    unsigned int x1 = 0;
+    unsigned int x2 = 0;
+    while (index < end)
     {
-      for(unsigned int y = static_cast<unsigned int>(x1); y < y2; ++y)
+      if (shown(curr[index]) != shown(prev[index]))
       {
-        Draw(toWrite, static_cast<float>(x), static_cast<float>(y), color);
+        const unsigned int y = index / width_;
+        const unsigned int x = index % width_;
+        if (x2 > x1 && (y != row || x > x2 + DamageGap))
+        {
+          addDamage(damage, row, x1, x2);
+          x1 = x2;
+        }
+
+        if (x2 == x1)
+        {
+          row = y;
+          x1 = x;
+        }
+        x2 = x + 1;
       }
+
+      index = isRetained_ ? modified_.NextSet(index + 1) : index + 1;
+    }
+    if (x2 > x1)
+      addDamage(damage, row, x1, x2);
+
+    // Widened rectangles can reach into ones that were already done.
+    std::vector<CanvasRect> &rects = damage.rects_;
+    bool merged = true;
+    while (merged)
+    {
+      merged = false;
+      for (size_t i = 0; i < rects.size() && !merged; ++i)
+        for (size_t j = i + 1; j < rects.size() && !merged; ++j)
+          if (rects[i].Overlaps(rects[j]))
+          {
+            rects[i].Merge(rects[j]);
+            rects.erase(rects.begin() + j);
+            merged = true;
+          }
+    }
+
+    size_t count = 0;
+    for (const CanvasRect &rect : rects)
+    {
+      damage.offsets_.push_back(count);
+      count += (rect.X2 - rect.X1) * (rect.Y2 - rect.Y1);
     }
+
+    damage.cells_.resize(count);
+    RasterInfo *out = damage.cells_.data();
+    for (const CanvasRect &rect : rects)
+      for (unsigned int y = rect.Y1; y < rect.Y2; ++y)
+        for (unsigned int x = rect.X1; x < rect.X2; ++x)
+        {
+          // Cells covered by a wide character to their left go out as 0.
+          *out = shown(curr[y * width_ + x]);
+          if (out->Value == Unicode::Continuation)
+            out->Value = 0;
+          ++out;
+        }
   }
 
 
-  //Set visibility of cursor to specified bool.
-  inline void Canvas::SetCursorVisible(bool isVisible)
+  // Adds a run of changed cells on a row, growing a rectangle that reaches the row above
+  // or this one if the run is close enough to it.
+  inline void Terminal::addDamage(FrameDamage &damage, unsigned int y, unsigned int x1, unsigned int x2) const
   {
-    if (!isVisible)
-      rlutil::hidecursor();
-    else
-      rlutil::showcursor();
+    std::vector<CanvasRect> &rects = damage.rects_;
+
+    // Rectangles ending above the row before can't grow any more, so they are moved in
+    // front of the open ones and no longer looked at.
+    for (size_t i = damage.open_; i < rects.size(); ++i)
+      if (rects[i].Y2 < y)
+        std::swap(rects[i], rects[damage.open_++]);
+
+    for (size_t i = damage.open_; i < rects.size(); ++i)
+    {
+      CanvasRect &rect = rects[i];
+      if (x1 <= rect.X2 + DamageGap && rect.X1 <= x2 + DamageGap)
+      {
+        rect.Merge(CanvasRect(x1, y, x2, y + 1));
+        return;
+      }
+    }
+
+    rects.push_back(CanvasRect(x1, y, x2, y + 1));
   }
 
 
-  // Gets the width of the console
-  inline unsigned int Canvas::GetConsoleWidht()
+  // A cell as it shows on screen. Cells never drawn to are blank.
+  inline RasterInfo Terminal::shown(const RasterInfo &ri)
   {
-    return width_;
+    if (ri.Value == 0)
+      return RasterInfo(' ', WHITE);
+    return ri;
   }
 
 
-  // Gets the height of the console
-  inline unsigned int Canvas::GetConsoleHeight()
+  // Grows the span of cells drawn to since the last update.
+  inline void Terminal::markDirty(unsigned int begin, unsigned int end)
   {
-    return height_;
+    if (begin < dirtyBegin_) dirtyBegin_ = begin;
+    if (end > dirtyEnd_) dirtyEnd_ = end;
   }
 
-    //////////////////////////////
-   // Private Member Functions //
-  //////////////////////////////
-  // Clears out the screen based on the previous items written. Clear character is a space.
-  inline void Canvas::clearPrevious()
+
+  // Explicitly clears every possible index. This is expensive! 
+  inline void Terminal::fullClear()
   {
-    // Walk through, write over only what was modified.
-    modified_.SetIndex(0);
-    unsigned int maxIndex = width_ * height_;
-    unsigned int index = 0;
-    while (index < maxIndex)
-    {
-      index = modified_.GetIndex();
-      const RasterInfo &curr = r_.GetRasterData().Peek(index);
-      const RasterInfo &prev = prev_.GetRasterData().Peek(index);
+    // Clearing fills with the background, so it has to be the default one.
+    setColor(out_, pen_, WHITE, CellColor());
 
-      // If we have not modified the space,
-      // and we don't have the same character as last time,
-      // and we don't have the same color.
-      if (!modified_.Get() && curr != prev)
-      {
-        // Compute X and Y location
-        unsigned int xLoc = (index % width_) + 1;
-        unsigned int yLoc = (index / width_) + 1;
+    #if defined(OS_WINDOWS) && !defined(RLUTIL_USE_ANSI)
+    if (isConsole_)
+    {
+      rlutil::cls();
+      return;
+    }
+    #endif
 
-        // locate on screen and set color
-        rlutil::locate(xLoc, yLoc);
+    out_ += "\033[2J\033[H";
+  }
 
-        putC(' ', stdout);
-      }
-      modified_.IncrementX();
+  
+  // Set the colors in the console using utility, if applicable, brought down to the depth
+  // output has. Nothing is written if the pen already has them.
+  inline void Terminal::setColor(std::string &out, Pen &pen, CellColor fg, CellColor bg)
+  {
+    #if defined(OS_WINDOWS) && !defined(RLUTIL_USE_ANSI)
+    if (isConsole_)
+    {
+      const Color fore = Palette::BasicOf(fg, GREY);
+      const Color back = Palette::BasicOf(bg, BLACK);
+      if (pen.Known && pen.Fg == CellColor(fore) && pen.Bg == CellColor(back))
+        return;
+      rlutil::setColor(fore | (back << 4));
+      pen.Known = true;
+      pen.Fg = fore;
+      pen.Bg = back;
+      return;
     }
+    #endif
 
-    // Set things back to zero.
-    modified_.Zero();
+    Palette::Sgr(out, pen, Palette::Quantize(fg, depth_), Palette::Quantize(bg, depth_));
   }
 
 
-  // Explicitly clears every possible index. This is expensive! 
-  inline void Canvas::fullClear()
+  // Moves the cursor, 1 based.
+  inline void Terminal::locate(std::string &out, unsigned int x, unsigned int y)
   {
-    rlutil::cls();
-  }
+    #if defined(OS_WINDOWS) && !defined(RLUTIL_USE_ANSI)
+    if (isConsole_)
+    {
+      rlutil::locate(x, y);
+      return;
+    }
+    #endif
 
-  
-  // Set the color in the console using utility, if applicable.
-  inline void Canvas::setColor(const Color &color)
-  {
-    if (color != PREVIOUS_COLOR)
-      rlutil::setColor(color);
+    char sequence[32];
+    const int len = snprintf(sequence, sizeof(sequence), "\033[%u;%uH", y, x);
+    out.append(sequence, static_cast<size_t>(len));
   }
 
 
-  // Write the raster we were attempting to write.
-  inline bool Canvas::writeRaster(CanvasRaster &r)
+  // Write the raster we were attempting to write, from begin up to end.
+  inline bool Terminal::writeRaster(const CanvasRaster &r, std::string &out, Pen &pen, unsigned int begin, unsigned int end)
   {
-    // Set initial position.
-    unsigned int maxIndex = width_ * height_;
-    r.GetRasterData().SetIndex(0);
-    unsigned int index = 0;
-    while(index < maxIndex)
+    // Walk both rasters in memory order.
+    const RasterInfo *cells = r.GetRasterData().begin();
+    const RasterInfo *prevs = prev_.GetRasterData().begin();
+    for (unsigned int index = begin; index < end; ++index)
     {
-      index = r.GetRasterData().GetIndex();
-      const RasterInfo& ri = r.GetRasterData().Get();
+      const RasterInfo &ri = cells[index];
 
-      if (ri.Value != 0 && prev_.GetRasterData().Peek(index) != ri)
+      if (ri.Value != 0 && ri.Value != Unicode::Continuation && prevs[index] != ri)
       {
         unsigned int xLoc = (index % width_) + 1;
         unsigned int yLoc = (index / width_) + 1;
@@ -1638,58 +4904,82 @@ namespace RConsole
 
 
         // locate on screen and set color
-        rlutil::locate(xLoc, yLoc);
+        locate(out, xLoc, yLoc);
 
         // Set color of cursor
-        setColor(ri.C);
+        setColor(out, pen, ri.C, ri.Bg);
 
         // Print out to the console in the preferred fashion
-        int retVal = 0;
-
-        retVal = putC(ri.Value, stdout);
-
-        if (!retVal)
-          return false;
+        putC(out, ri.Value);
       }
-
-      // Increment X location
-      r.GetRasterData().IncrementX();
     }
 
     // Return we successfully printed the raster!
     return true;
   }
 
-  // Cross-platform putc
-  inline int Canvas::putC(int character, FILE * stream )
+  // Cross-platform putc, encoding to UTF-8.
+  inline void Terminal::putC(std::string &out, char32_t character)
   {
-    #if defined(RConsole_NO_THREADING) && defined(OS_WINDOWS)
-      return _putc_nolock(character, stream);
-    #else
-      return putc(character, stream);
+    #if defined(OS_WINDOWS) && !defined(RLUTIL_USE_ANSI)
+    if (isConsole_)
+    {
+      char bytes[4];
+      const size_t len = Unicode::Encode(bytes, character);
+      for (size_t i = 0; i < len; ++i)
+      {
+        #ifdef RConsole_NO_THREADING
+        _putc_nolock(bytes[i], stdout);
+        #else
+        putc(bytes[i], stdout);
+        #endif
+      }
+      return;
+    }
     #endif
+
+    if (character < 0x80)
+      out += static_cast<char>(character);
+    else
+      Unicode::Encode(out, character);
+  }
+
+
+  // Hands everything collected so far to the sink.
+  inline void Terminal::flush()
+  {
+    sink_->Write(out_.data(), out_.size());
+    out_.clear();
   }
 
 
   // print out the formatted raster.
   // Note that because of console color formatting, we use the RLUTIL coloring option when
   // we are printing to the console, or have no file output specified.
-  inline void Canvas::DumpRaster(FILE * fp)
+  inline void Terminal::DumpRaster(FILE * fp) const
   {
+    Pen pen;
+
     // Dump only relevant part of stream.
     for (unsigned int i = 0; i < height_; ++i)
     {
-      for (unsigned int j = 0; j < width_; ++j)
+      for (const RasterInfo &ri : r_.GetRasterData().Row(i))
       {
-        const RasterInfo &ri = r_.GetRasterData().Peek(j, i);
+        if (ri.Value == Unicode::Continuation)
+          continue;
+
+        std::string glyph;
+        Unicode::Encode(glyph, ri.Value);
         if (fp == stdout)
         {
-          rlutil::setColor(ri.C);
-          std::cout << ri.Value;//fprintf(fp, "%c", ri.Value);
+          rlutil::setColor(Palette::BasicOf(ri.C, WHITE));
+          std::cout << glyph;//fprintf(fp, "%c", ri.Value);
         }
         else
         {
-          std::string line = rlutil::getANSIColor(ri.C) + ri.Value;
+          std::string line;
+          Palette::Sgr(line, pen, ri.C, ri.Bg);
+          line += glyph;
           fprintf(fp, "%s", line.c_str());
         }
       }
@@ -1705,19 +4995,22 @@ namespace RConsole
 
 
   // Crops all of the raster
-  inline void Canvas::CropRaster(FILE *fp, char toTrim)
+  inline void Terminal::CropRaster(FILE *fp, char toTrim) const
   {
+    Pen pen;
+
     // Establish borders.
     unsigned int Xmin = width_;
     unsigned int Xmax = 0;
     unsigned int Ymin = height_;
     unsigned int Ymax = 0;
 
-    for (unsigned int i = 0; i < width_; ++i)
+    for (unsigned int j = 0; j < height_; ++j)
     {
-      for (unsigned int j = 0; j < height_; ++j)
+      const Field2DRow<const RasterInfo> row = r_.GetRasterData().Row(j);
+      for (unsigned int i = 0; i < width_; ++i)
       {
-        if (r_.GetRasterData().Peek(i, j).Value != toTrim)
+        if (row[i].Value != static_cast<unsigned char>(toTrim))
         {
           if (i < Xmin) Xmin = i;
           if (j < Ymin) Ymin = j;
@@ -1734,17 +5027,25 @@ namespace RConsole
     // Dump only relevant part of stream.
     for (unsigned int j = Ymin; j <= Ymax; ++j)
     {
+      const Field2DRow<const RasterInfo> row = r_.GetRasterData().Row(j);
       for (unsigned int i = Xmin; i <= Xmax; ++i)
       {
-        const RasterInfo &ri = r_.GetRasterData().Peek(i, j);
+        const RasterInfo &ri = row[i];
+        if (ri.Value == Unicode::Continuation)
+          continue;
+
+        std::string glyph;
+        Unicode::Encode(glyph, ri.Value);
         if (fp == stdout)
         {
-          rlutil::setColor(ri.C);
-          fprintf(fp, "%c", ri.Value);
+          rlutil::setColor(Palette::BasicOf(ri.C, WHITE));
+          fprintf(fp, "%s", glyph.c_str());
         }
         else
         {
-          std::string line = rlutil::getANSIColor(ri.C) + ri.Value;
+          std::string line;
+          Palette::Sgr(line, pen, ri.C, ri.Bg);
+          line += glyph;
           fprintf(fp, "%s", line.c_str());
         }
       }
@@ -1774,4 +5075,55 @@ namespace RConsole
     signal(SIGTERM, signalHandler);
     signal(SIGINT, signalHandler);
   }
+
+
+  // Notes the terminal changed size. Asking for the size isn't safe from a signal
+  // handler, so that waits for PollResize.
+  inline void Canvas::onResize(int signalNum)
+  {
+    UNUSED(signalNum);
+    resized_ = 1;
+  }
+
+
+  // Listens for the terminal changing size. Reads are restarted rather than failing when
+  // it happens. Windows has no such signal, so PollResize asks every time there.
+  inline void Canvas::setResizeHandler()
+  {
+    #ifndef OS_WINDOWS
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onResize;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGWINCH, &action, nullptr);
+    #endif
+  }
+
+
+  // Resizes the canvas to the terminal once it changed size, keeping what was drawn so only
+  // newly exposed cells are written on the next update. Call from the loop that draws.
+  // Returns if the size changed.
+  inline bool Canvas::PollResize()
+  {
+    #ifndef OS_WINDOWS
+    if (resized_ == 0)
+      return false;
+    resized_ = 0;
+
+    // The size is asked of the terminal on input, like at startup.
+    if (!isatty(STDIN_FILENO))
+      return false;
+    #endif
+
+    const int width = rlutil::tcols() - 1;
+    const int height = rlutil::trows() - 1;
+    if (width <= 0 || height <= 0)
+      return false;
+    if (static_cast<unsigned int>(width) == terminal_.GetConsoleWidht() && static_cast<unsigned int>(height) == terminal_.GetConsoleHeight())
+      return false;
+
+    terminal_.Resize(static_cast<unsigned int>(width), static_cast<unsigned int>(height));
+    return true;
+  }
 }
@@ -7,50 +7,143 @@
 @copyright See LICENSE.md
 *****************************************************************************/
 #include "menu-system.hpp"
-#include "conio.h"
+#include "menu-loader.hpp"
+#include "menu-image.hpp"
+#include "menu-server.hpp"
 #include "console-input.h"
 
 
 // Application entry point. Note the order of events for menu initialization:
 // It requires you to establish a base menu along with a series of different
-// smaller sub-menus, or containers. 
-int main()
+// smaller sub-menus, or containers. Passing a menu file path loads the menus
+// from that file instead, see Resources/menus.txt. Files can be precompiled
+// into a binary image with --compile <menu file> <image file>, and an image
+// can be passed in place of the menu file. On Linux, --serve <address> serves
+// the menus to socket connections instead of the console, and
+// --load <address> <clients> <seconds> load tests such a server.
+int main(int argc, char *argv[])
 {
+  // Compile a menu file to an image and exit.
+  if (argc > 3 && std::string(argv[1]) == "--compile")
+  {
+    MenuLoader compileLoader;
+    if (!compileLoader.Load(argv[2]) || !MenuImageCompiler::Write(compileLoader.GetDefinition(), argv[3]))
+    {
+      std::cout << "Unable to compile " << argv[2] << " " << compileLoader.GetError() << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
+#ifdef OS_LINUX
+  // Simulate clients against a menu server and report what they saw.
+  if (argc > 4 && std::string(argv[1]) == "--load")
+  {
+    LoadGenerator generator(argv[2], std::stoul(argv[3]));
+    if (!generator.Run(std::stod(argv[4])))
+    {
+      std::cout << generator.GetError() << std::endl;
+      return 1;
+    }
+
+    const LoadGenerator::Report &report = generator.GetReport();
+    std::cout << report.Clients << " clients, " << report.Frames << " frames in " << report.Seconds << "s, "
+              << report.FramesPerSecond << " frames/s" << std::endl;
+    std::cout << "latency ms p50 " << report.P50 << " p90 " << report.P90 << " p99 " << report.P99 << " max " << report.Max << std::endl;
+    return 0;
+  }
+#endif
+
+  // Serving builds the default menus, and skips the console.
+  const bool serving = argc > 2 && std::string(argv[1]) == "--serve";
+
+  // Menus from an image or a file, if one was given.
+  MenuImage image;
+  MenuLoader loader;
+  loader.RegisterAction("exit", []() { exit(0); });
+  if (argc > 1 && !serving)
+  {
+    if (image.Open(argv[1]))
+      image.RegisterAction("exit", []() { exit(0); });
+    else if (!loader.Load(argv[1]))
+    {
+      std::cout << loader.GetError() << std::endl;
+      return 1;
+    }
+    else
+      loader.Watch();
+  }
+
   // Pre-menu init
-  ASCIIMenus::RConsole::Canvas::ReInit(60, 20);
-  ASCIIMenus::RConsole::Canvas::SetCursorVisible(false);
+  if (!serving)
+  {
+    RConsole::Canvas::ReInit(60, 20);
+    RConsole::Canvas::SetCursorVisible(false);
+  }
 
   // ====== Start menu init section ======
-  Container *mainMenu = Container::Create("mainMenu");
-  mainMenu->SetOrientation(ASCIIMenus::HORIZONTAL);
-  mainMenu->AddItem("|  Mode select  |", "gamemode");
-  mainMenu->AddItem("| Shopping List |", "shopping");
-  mainMenu->AddItem("|     Exit      |", "exit", []() { exit(0); });
-
-  Container *gamemodeMenu = Container::Create("gamemode");
-  gamemodeMenu->SetOrientation(ASCIIMenus::VERTICAL);
-  gamemodeMenu->SetPosition(0, 1);
-  gamemodeMenu->AddItem("| Mode1 |", "");
-  gamemodeMenu->AddItem("| Mode2 |", "");
-  gamemodeMenu->AddItem("| Back  |", "back");
+  Container *mainMenu = nullptr;
+  Container *gamemodeMenu = nullptr;
+  Container *shoppingMenu = nullptr;
+  if (argc <= 1 || serving)
+  {
+    mainMenu = Container::Create("mainMenu");
+    mainMenu->SetOrientation(ASCIIMenus::HORIZONTAL);
+    mainMenu->AddItem("|  Mode select  |", "gamemode");
+    mainMenu->AddItem("| Shopping List |", "shopping");
+    mainMenu->AddItem("|     Exit      |", "exit", []() { exit(0); });
+
+    gamemodeMenu = Container::Create("gamemode");
+    gamemodeMenu->SetOrientation(ASCIIMenus::VERTICAL);
+    gamemodeMenu->SetPosition(0, 1);
+    gamemodeMenu->AddItem("| Mode1 |", "");
+    gamemodeMenu->AddItem("| Mode2 |", "");
+    gamemodeMenu->AddItem("| Back  |", "back");
   
-  Container *shoppingMenu = Container::Create("shopping");
-  shoppingMenu->SetOrientation(ASCIIMenus::VERTICAL);
-  shoppingMenu->SetPosition(17, 1);
-  shoppingMenu->AddItem("| Carrots |", "");
-  shoppingMenu->AddItem("|  Spam   |", "");
-  shoppingMenu->AddItem("|  Chips  |", "");
-  shoppingMenu->AddItem("| Lettuce |", "");
-  shoppingMenu->AddItem("| Oatmeal |", "");
-  shoppingMenu->AddItem("|  Back   |", "back");
+    shoppingMenu = Container::Create("shopping");
+    shoppingMenu->SetOrientation(ASCIIMenus::VERTICAL);
+    shoppingMenu->SetPosition(17, 1);
+    shoppingMenu->AddItem("| Carrots |", "");
+    shoppingMenu->AddItem("|  Spam   |", "");
+    shoppingMenu->AddItem("|  Chips  |", "");
+    shoppingMenu->AddItem("| Lettuce |", "");
+    shoppingMenu->AddItem("| Oatmeal |", "");
+    shoppingMenu->AddItem("|  Back   |", "back");
+  }
+
+#ifdef OS_LINUX
+  if (serving)
+  {
+    MenuServer server("mainMenu", 60, 20);
+    if (!server.Listen(argv[2]))
+    {
+      std::cout << server.GetError() << std::endl;
+      return 1;
+    }
+
+    server.Start();
+    std::cout << "Serving menus on " << argv[2] << std::endl;
+    for (;;)
+      std::this_thread::sleep_for(std::chrono::seconds(1));
+  }
+#endif
 
   MenuSystem testBlock("mainMenu");
-  testBlock.SetColorSelected(ASCIIMenus::RConsole::LIGHTMAGENTA);
-  testBlock.SetColorUnselected(ASCIIMenus::RConsole::GREY);
+  testBlock.SetColorSelected(RConsole::LIGHTMAGENTA);
+  testBlock.SetColorUnselected(RConsole::GREY);
+  testBlock.SetRetained(true);
+  RConsole::Canvas::SetRetained(true);
   // ====== End menu init system ======
 
   while(1)
   {
+    // Pick up edits to the menu file.
+    if (loader.Poll())
+      testBlock.Revalidate();
+
+    // Follow the terminal's size. Only what changed is drawn again.
+    RConsole::Canvas::PollResize();
+
     if(KeyHit())
     {
       int c = GetChar();
@@ -0,0 +1,453 @@
+/*!***************************************************************************
+@file    menu-image.hpp
+@author  mc-w
+@date    10/18/2026
+@brief   Precompiled binary menu images that are used straight from a mapping.
+
+A menu image is a resolved menu definition flattened into one block of
+fixed size records that refer to each other by offset, never by pointer:
+
+  [header][containers][items][sorted name index][action names][text]
+
+Mounting an image maps the file and checks the header and block bounds,
+nothing else. The registry asks the image for containers by binary searching
+the name index, each record and its items are checked the first time it is
+asked for, and containers read their items directly out of the mapping, so
+startup cost and memory don't grow with the number of menus. Items leading
+to another menu in the image go straight to its record. Since the mapping is
+read only, processes using the same image share its pages.
+
+@copyright (See LICENSE.md)
+*****************************************************************************/
+#pragma once
+#include "menu-system.hpp"
+#include "menu-loader.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+
+
+//////////////////////////////////////////////////////
+// On disk layout. Everything is a 32 bit value so records stay aligned in the mapping.
+//////////////////////////////////////////////////////
+namespace MenuImageFormat
+{
+  static const char Magic[4] = { 'A', 'M', 'N', 'U' };
+  static const uint32_t Version = 1;
+  static const uint32_t NoIndex = 0xFFFFFFFF;
+
+  // Offsets are in bytes from the start of the image.
+  struct Header
+  {
+    char Magic[4];
+    uint32_t Version;
+    uint32_t TotalSize;
+    uint32_t ContainerCount;
+    uint32_t ContainerOffset;
+    uint32_t ItemCount;
+    uint32_t ItemOffset;
+    uint32_t NameIndexOffset;
+    uint32_t ActionCount;
+    uint32_t ActionOffset;
+    uint32_t TextOffset;
+    uint32_t TextSize;
+  };
+
+  // Text is an offset into the text block and a length.
+  struct TextRef
+  {
+    uint32_t Offset;
+    uint32_t Size;
+  };
+
+  struct ContainerRecord
+  {
+    TextRef Name;
+    uint32_t Orientation;
+    uint32_t X;
+    uint32_t Y;
+    uint32_t FirstItem;
+    uint32_t ItemCount;
+  };
+
+  // Target is resolved to a container index at compile time when it names one.
+  struct ItemRecord
+  {
+    TextRef Label;
+    TextRef Target;
+    uint32_t TargetIndex;
+    uint32_t ActionIndex;
+  };
+}
+
+
+//////////////////////////////////////////////////////
+// Flattens a parsed definition into an image.
+//////////////////////////////////////////////////////
+class MenuImageCompiler
+{
+public:
+  // Builds the image in memory. Container names are unique, as the parser makes sure of.
+  static void Compile(const MenuDefinition &def, std::vector<char> &out)
+  {
+    using namespace MenuImageFormat;
+
+    std::string text;
+    std::map<std::string, uint32_t> containerIndex;
+    std::map<std::string, uint32_t> actionIndex;
+    std::vector<TextRef> actions;
+
+    for (size_t i = 0; i < def.Containers.size(); ++i)
+      containerIndex[def.Containers[i].Name.Str()] = static_cast<uint32_t>(i);
+
+    // Containers
+    std::vector<ContainerRecord> containers(def.Containers.size());
+    for (size_t i = 0; i < def.Containers.size(); ++i)
+    {
+      const MenuContainerDef &src = def.Containers[i];
+      ContainerRecord &dst = containers[i];
+      dst.Name = addText(text, src.Name);
+      dst.Orientation = static_cast<uint32_t>(src.Orientation);
+      dst.X = static_cast<uint32_t>(src.X);
+      dst.Y = static_cast<uint32_t>(src.Y);
+      dst.FirstItem = static_cast<uint32_t>(src.FirstItem);
+      dst.ItemCount = static_cast<uint32_t>(src.ItemCount);
+    }
+
+    // Items, with targets and actions resolved to indices.
+    std::vector<ItemRecord> items(def.Items.size());
+    for (size_t i = 0; i < def.Items.size(); ++i)
+    {
+      const MenuItemDef &src = def.Items[i];
+      ItemRecord &dst = items[i];
+      dst.Label = addText(text, src.Label);
+      dst.Target = addText(text, src.Target);
+
+      auto target = containerIndex.find(src.Target.Str());
+      dst.TargetIndex = (target != containerIndex.end()) ? target->second : NoIndex;
+
+      dst.ActionIndex = NoIndex;
+      if (!src.Action.Empty())
+      {
+        auto action = actionIndex.find(src.Action.Str());
+        if (action == actionIndex.end())
+        {
+          action = actionIndex.insert(std::make_pair(src.Action.Str(), static_cast<uint32_t>(actions.size()))).first;
+          actions.push_back(addText(text, src.Action));
+        }
+        dst.ActionIndex = action->second;
+      }
+    }
+
+    // Name index is container indices sorted by name, std::map already has them in order.
+    std::vector<uint32_t> nameIndex;
+    nameIndex.reserve(containerIndex.size());
+    for (const auto &entry : containerIndex)
+      nameIndex.push_back(entry.second);
+
+    // Lay out the blocks.
+    Header header;
+    memcpy(header.Magic, Magic, sizeof(Magic));
+    header.Version = Version;
+    header.ContainerCount = static_cast<uint32_t>(containers.size());
+    header.ContainerOffset = sizeof(Header);
+    header.ItemCount = static_cast<uint32_t>(items.size());
+    header.ItemOffset = header.ContainerOffset + static_cast<uint32_t>(containers.size() * sizeof(ContainerRecord));
+    header.NameIndexOffset = header.ItemOffset + static_cast<uint32_t>(items.size() * sizeof(ItemRecord));
+    header.ActionCount = static_cast<uint32_t>(actions.size());
+    header.ActionOffset = header.NameIndexOffset + static_cast<uint32_t>(nameIndex.size() * sizeof(uint32_t));
+    header.TextOffset = header.ActionOffset + static_cast<uint32_t>(actions.size() * sizeof(TextRef));
+    header.TextSize = static_cast<uint32_t>(text.size());
+    header.TotalSize = header.TextOffset + header.TextSize;
+
+    out.clear();
+    out.reserve(header.TotalSize);
+    append(out, &header, sizeof(header));
+    append(out, containers.data(), containers.size() * sizeof(ContainerRecord));
+    append(out, items.data(), items.size() * sizeof(ItemRecord));
+    append(out, nameIndex.data(), nameIndex.size() * sizeof(uint32_t));
+    append(out, actions.data(), actions.size() * sizeof(TextRef));
+    append(out, text.data(), text.size());
+  }
+
+  // Builds the image and writes it to a file. Returns if it was successful or not.
+  static bool Write(const MenuDefinition &def, const std::string &path)
+  {
+    std::vector<char> image;
+    Compile(def, image);
+
+    FILE *fp = fopen(path.c_str(), "wb");
+    if (fp == nullptr)
+      return false;
+
+    const bool written = fwrite(image.data(), 1, image.size(), fp) == image.size();
+    return (fclose(fp) == 0) && written;
+  }
+
+private:
+  // Appends raw bytes.
+  static void append(std::vector<char> &out, const void *data, size_t size)
+  {
+    const char *bytes = static_cast<const char *>(data);
+    out.insert(out.end(), bytes, bytes + size);
+  }
+
+  // Copies text into the text block.
+  static MenuImageFormat::TextRef addText(std::string &text, const ASCIIMenus::Text &str)
+  {
+    MenuImageFormat::TextRef ref;
+    ref.Offset = static_cast<uint32_t>(text.size());
+    ref.Size = static_cast<uint32_t>(str.Size());
+    text.append(str.Data(), str.Size());
+    return ref;
+  }
+};
+
+
+//////////////////////////////////////////////////////
+// A mounted menu image. Serves as both the directory the registry searches for names and
+// the item source its containers read from. Must outlive any menu system using it.
+//////////////////////////////////////////////////////
+class MenuImage : public ContainerDirectory, public ItemSource
+{
+public:
+  // Ctor and dtor
+  MenuImage() : file_(), header_(nullptr), actions_(), containers_(), materialize_(), error_() {  }
+  ~MenuImage() { Close(); }
+
+  // Associates an action name in the image with a callback.
+  void RegisterAction(const std::string &name, ASCIIMenus::CallbackFunction function)
+  {
+    if (header_ == nullptr)
+      return;
+
+    for (uint32_t i = 0; i < header_->ActionCount; ++i)
+      if (text(action(i)) == name)
+        actions_[i] = function;
+  }
+
+  // Maps the image and validates its header, then mounts it in the registry. Records are
+  // checked when they are first used, so a corrupt one only fails its own lookups.
+  bool Open(const std::string &path)
+  {
+    using namespace MenuImageFormat;
+    Close();
+
+    if (!file_.Open(path))
+      return fail("unable to open " + path);
+
+    const Header *header = reinterpret_cast<const Header *>(file_.Data());
+    if (file_.Size() < sizeof(Header) || memcmp(header->Magic, Magic, sizeof(Magic)) != 0)
+      return fail(path + " is not a menu image");
+    if (header->Version != Version)
+      return fail(path + " has an unsupported image version");
+    if (!validate(*header, file_.Size()))
+      return fail(path + " is truncated or corrupt");
+
+    header_ = header;
+    actions_.assign(header_->ActionCount, nullptr);
+    MenuRegistry::Mount(this);
+    return true;
+  }
+
+  // Unmounts, deletes the containers handed out, and releases the mapping.
+  void Close()
+  {
+    if (header_ == nullptr)
+      return;
+
+    MenuRegistry::Unmount(this);
+    for (auto &entry : containers_)
+      delete entry.second;
+    containers_.clear();
+    actions_.clear();
+    header_ = nullptr;
+    file_.Close();
+  }
+
+  // Accessors
+  const std::string &GetError() const { return error_; }
+  size_t GetContainerCount() const    { return header_ ? header_->ContainerCount : 0; }
+
+  // ContainerDirectory: binary search the name index. Containers are only created the
+  // first time they are asked for, and kept here instead of registered, since registering
+  // copies the registry for each one.
+  Container *Find(const std::string &name) override
+  {
+    if (header_ == nullptr)
+      return nullptr;
+
+    const uint32_t *index = at<uint32_t>(header_->NameIndexOffset);
+    size_t low = 0;
+    size_t high = header_->ContainerCount;
+    while (low < high)
+    {
+      const size_t mid = low + (high - low) / 2;
+      if (index[mid] >= header_->ContainerCount)
+        return nullptr;
+
+      const MenuImageFormat::ContainerRecord &c = container(index[mid]);
+      const int cmp = compare(text(c.Name), name);
+      if (cmp == 0)
+        return materialize(index[mid]);
+      if (cmp < 0)
+        low = mid + 1;
+      else
+        high = mid;
+    }
+
+    return nullptr;
+  }
+
+  // ItemSource: items are built around borrowed text, so this doesn't allocate.
+  size_t Count(size_t id) const override
+  {
+    return container(static_cast<uint32_t>(id)).ItemCount;
+  }
+
+  Selectable Get(size_t id, size_t index) const override
+  {
+    const MenuImageFormat::ContainerRecord &c = container(static_cast<uint32_t>(id));
+    const MenuImageFormat::ItemRecord &item = at<MenuImageFormat::ItemRecord>(header_->ItemOffset)[c.FirstItem + index];
+    ASCIIMenus::CallbackFunction function = nullptr;
+    if (item.ActionIndex != MenuImageFormat::NoIndex)
+      function = actions_[item.ActionIndex];
+
+    return Selectable(text(item.Label), text(item.Target), function);
+  }
+
+  Container *Target(size_t id, size_t index) const override
+  {
+    const MenuImageFormat::ContainerRecord &c = container(static_cast<uint32_t>(id));
+    const MenuImageFormat::ItemRecord &item = at<MenuImageFormat::ItemRecord>(header_->ItemOffset)[c.FirstItem + index];
+    if (item.TargetIndex == MenuImageFormat::NoIndex)
+      return nullptr;
+    return materialize(item.TargetIndex);
+  }
+
+private:
+  // Typed access into the mapping.
+  template <typename T>
+  const T *at(uint32_t offset) const
+  {
+    return reinterpret_cast<const T *>(file_.Data() + offset);
+  }
+
+  const MenuImageFormat::ContainerRecord &container(uint32_t i) const
+  {
+    return at<MenuImageFormat::ContainerRecord>(header_->ContainerOffset)[i];
+  }
+
+  const MenuImageFormat::TextRef &action(uint32_t i) const
+  {
+    return at<MenuImageFormat::TextRef>(header_->ActionOffset)[i];
+  }
+
+  ASCIIMenus::Text text(const MenuImageFormat::TextRef &ref) const
+  {
+    if (static_cast<uint64_t>(ref.Offset) + ref.Size > header_->TextSize)
+      return ASCIIMenus::Text();
+    return ASCIIMenus::Text::Borrow(file_.Data() + header_->TextOffset + ref.Offset, ref.Size);
+  }
+
+  // Orders the same way std::string does, which is how the compiler sorted the index.
+  static int compare(const ASCIIMenus::Text &lhs, const std::string &rhs)
+  {
+    const size_t len = std::min(lhs.Size(), rhs.size());
+    const int cmp = memcmp(lhs.Data(), rhs.data(), len);
+    if (cmp != 0)
+      return cmp;
+    if (lhs.Size() == rhs.size())
+      return 0;
+    return lhs.Size() < rhs.size() ? -1 : 1;
+  }
+
+  // Creates the container object for an index, once. Null if its record is corrupt.
+  Container *materialize(uint32_t i) const
+  {
+    // Lookups from several threads can ask for the same container at once.
+    std::lock_guard<std::mutex> lock(materialize_);
+    auto iter = containers_.find(i);
+    if (iter != containers_.end())
+      return iter->second;
+    if (!check(i))
+      return nullptr;
+
+    const MenuImageFormat::ContainerRecord &c = container(i);
+    Container *con = Container::CreateUnregistered(text(c.Name).Str());
+    con->SetOrientation(static_cast<ASCIIMenus::Orientation>(c.Orientation));
+    con->SetPosition(c.X, c.Y);
+    con->SetSource(this, i);
+    containers_[i] = con;
+    return con;
+  }
+
+  // Checks that every block lies inside the image. Records are left to check().
+  static bool validate(const MenuImageFormat::Header &h, size_t size)
+  {
+    using namespace MenuImageFormat;
+    const uint32_t align = alignof(uint32_t);
+    if (h.ContainerOffset % align != 0 || h.ItemOffset % align != 0 || h.NameIndexOffset % align != 0 || h.ActionOffset % align != 0)
+      return false;
+
+    const uint64_t containersEnd = h.ContainerOffset + static_cast<uint64_t>(h.ContainerCount) * sizeof(ContainerRecord);
+    const uint64_t itemsEnd = h.ItemOffset + static_cast<uint64_t>(h.ItemCount) * sizeof(ItemRecord);
+    const uint64_t indexEnd = h.NameIndexOffset + static_cast<uint64_t>(h.ContainerCount) * sizeof(uint32_t);
+    const uint64_t actionsEnd = h.ActionOffset + static_cast<uint64_t>(h.ActionCount) * sizeof(TextRef);
+    const uint64_t textEnd = h.TextOffset + static_cast<uint64_t>(h.TextSize);
+    return h.TotalSize == size && containersEnd <= size && itemsEnd <= size && indexEnd <= size && actionsEnd <= size && textEnd <= size;
+  }
+
+  // Checks that a container record and its items only refer to what is in the image, so
+  // nothing read through its container has to be checked again. Name index entries and
+  // action names are checked where they are read.
+  bool check(uint32_t i) const
+  {
+    using namespace MenuImageFormat;
+    const ContainerRecord &c = container(i);
+    if (static_cast<uint64_t>(c.FirstItem) + c.ItemCount > header_->ItemCount)
+      return false;
+    if (!fits(c.Name) || c.Orientation > ASCIIMenus::VERTICAL)
+      return false;
+
+    const ItemRecord *items = at<ItemRecord>(header_->ItemOffset) + c.FirstItem;
+    for (uint32_t n = 0; n < c.ItemCount; ++n)
+    {
+      const ItemRecord &item = items[n];
+      if (!fits(item.Label) || !fits(item.Target))
+        return false;
+      if (item.TargetIndex != NoIndex && item.TargetIndex >= header_->ContainerCount)
+        return false;
+      if (item.ActionIndex != NoIndex && item.ActionIndex >= header_->ActionCount)
+        return false;
+    }
+
+    return true;
+  }
+
+  // Returns if text lies inside the text block.
+  bool fits(const MenuImageFormat::TextRef &ref) const
+  {
+    return static_cast<uint64_t>(ref.Offset) + ref.Size <= header_->TextSize;
+  }
+
+  // Sets the error and returns false, for brevity.
+  bool fail(const std::string &reason)
+  {
+    error_ = reason;
+    file_.Close();
+    return false;
+  }
+
+  // Private variables
+  MappedFile file_;
+  const MenuImageFormat::Header *header_;
+  std::vector<ASCIIMenus::CallbackFunction> actions_;
+  mutable std::unordered_map<uint32_t, Container *> containers_;
+  mutable std::mutex materialize_;
+  std::string error_;
+};
@@ -0,0 +1,866 @@
+/*!***************************************************************************
+@file    menu-loader.hpp
+@author  mc-w
+@date    10/18/2026
+@brief   Loads menu containers from a text description instead of code.
+
+A menu file is a series of line based statements. Blank lines and lines
+starting with # are ignored, and every statement after a menu line applies
+to that menu:
+
+  menu mainMenu
+  orientation horizontal
+  position 0 0
+  item "| Mode select |" gamemode
+  item "|    Exit     |" exit @quit
+
+Items are a quoted label, an optional target menu name, and an optional
+@action naming a callback registered with the loader. Labels can't contain
+quotes since they are never unescaped or copied.
+
+A loaded file can be watched and hot reloaded while menus are in use, see
+MenuLoader::Watch and MenuLoader::Poll.
+
+@copyright (See LICENSE.md)
+*****************************************************************************/
+#pragma once
+#include "menu-system.hpp"
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <memory>
+#include <future>
+#include <chrono>
+#include <unordered_map>
+#include <cstdint>
+#include <ctime>
+#include <cstdio>
+#include <sys/stat.h>
+
+#ifdef OS_WINDOWS
+  #include <windows.h>
+#else
+  #include <sys/mman.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
+#ifdef OS_LINUX
+  #include <sys/inotify.h>
+#endif
+
+
+//////////////////////////////////////////////////////
+// Read-only memory mapping of a whole file. The mapping lives as long as the object.
+// Files that may be edited while in use are read into memory the object owns instead,
+// since truncating a mapped file makes reading past its new end fault.
+//////////////////////////////////////////////////////
+class MappedFile
+{
+public:
+  // Ctor and dtor
+  MappedFile() : data_(nullptr), size_(0), copy_() {  }
+  ~MappedFile() { Close(); }
+
+  // Maps the file at the path. Returns if it was successful or not.
+  bool Open(const std::string &path)
+  {
+    Close();
+
+  #ifdef OS_WINDOWS
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+      return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+      CloseHandle(file);
+      return size.QuadPart == 0;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr)
+      return false;
+
+    data_ = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    CloseHandle(mapping);
+    if (data_ == nullptr)
+      return false;
+
+    size_ = static_cast<size_t>(size.QuadPart);
+  #else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+      close(fd);
+      return false;
+    }
+
+    // Empty files can't be mapped, but are still valid.
+    if (info.st_size == 0)
+    {
+      close(fd);
+      return true;
+    }
+
+    void *mem = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED)
+      return false;
+
+    data_ = static_cast<const char *>(mem);
+    size_ = static_cast<size_t>(info.st_size);
+  #endif
+
+    return true;
+  }
+
+  // Reads the whole file into memory. Returns if it was successful or not.
+  bool Read(const std::string &path)
+  {
+    Close();
+
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (fp == nullptr)
+      return false;
+
+    // Read until the end instead of trusting the size, which an edit can change meanwhile.
+    const size_t chunk = 64 * 1024;
+    size_t size = 0;
+    for (;;)
+    {
+      copy_.resize(size + chunk);
+      const size_t read = fread(&copy_[size], 1, chunk, fp);
+      size += read;
+      if (read < chunk)
+        break;
+    }
+
+    const bool failed = ferror(fp) != 0;
+    fclose(fp);
+    copy_.resize(size);
+    if (failed)
+    {
+      copy_.clear();
+      return false;
+    }
+
+    data_ = copy_.empty() ? nullptr : copy_.data();
+    size_ = size;
+    return true;
+  }
+
+  // Releases the mapping or memory. Anything borrowing from it is invalid afterwards.
+  void Close()
+  {
+    if (data_ == nullptr)
+      return;
+
+    if (!copy_.empty())
+    {
+      std::vector<char>().swap(copy_);
+      data_ = nullptr;
+      size_ = 0;
+      return;
+    }
+
+  #ifdef OS_WINDOWS
+    UnmapViewOfFile(data_);
+  #else
+    munmap(const_cast<char *>(data_), size_);
+  #endif
+
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+  // Accessors
+  const char *Data() const { return data_; }
+  size_t Size() const      { return size_; }
+
+private:
+  // No copying a mapping.
+  MappedFile(const MappedFile &rhs);
+  MappedFile &operator=(const MappedFile &rhs);
+
+  // Private variables
+  const char *data_;
+  size_t size_;
+  std::vector<char> copy_;
+};
+
+
+
+//////////////////////////////////////////////////////
+// Parsed form of a menu file. All text is borrowed from the buffer that was parsed, and
+// items are stored in one flat array, so parsing allocates the same few times no matter
+// the size.
+//////////////////////////////////////////////////////
+struct MenuItemDef
+{
+  ASCIIMenus::Text Label;
+  ASCIIMenus::Text Target;
+  ASCIIMenus::Text Action;
+};
+
+struct MenuContainerDef
+{
+  ASCIIMenus::Text Name;
+  ASCIIMenus::Orientation Orientation;
+  size_t X;
+  size_t Y;
+  size_t FirstItem;
+  size_t ItemCount;
+  ASCIIMenus::Text Source;
+};
+
+struct MenuDefinition
+{
+  std::vector<MenuContainerDef> Containers;
+  std::vector<MenuItemDef> Items;
+};
+
+
+//////////////////////////////////////////////////////
+// Single pass parser over a character buffer. Tokens are views into the buffer.
+//////////////////////////////////////////////////////
+class MenuParser
+{
+public:
+  // Parses the buffer into the definition. On failure, the error holds the line and reason.
+  static bool Parse(const char *data, size_t size, MenuDefinition &def, std::string &error)
+  {
+    def.Containers.clear();
+    def.Items.clear();
+    reserve(data, size, def);
+
+    const char *end = data + size;
+    const char *line = data;
+    size_t lineNumber = 0;
+    while (line < end)
+    {
+      const char *lineEnd = static_cast<const char *>(memchr(line, '\n', end - line));
+      if (lineEnd == nullptr)
+        lineEnd = end;
+      ++lineNumber;
+
+      if (!parseLine(line, lineEnd, def, error))
+      {
+        error = "line " + std::to_string(lineNumber) + ": " + error;
+        return false;
+      }
+
+      // Every line up to the next menu belongs to the current one.
+      if (!def.Containers.empty())
+      {
+        MenuContainerDef &con = def.Containers.back();
+        con.Source = ASCIIMenus::Text::Borrow(con.Source.Data(), lineEnd - con.Source.Data());
+      }
+
+      line = lineEnd + 1;
+    }
+
+    return checkNames(data, def, error);
+  }
+
+private:
+  // Menus find each other by name, so a name can only be defined once. Fails naming the
+  // line of the second definition.
+  static bool checkNames(const char *data, const MenuDefinition &def, std::string &error)
+  {
+    std::vector<size_t> order(def.Containers.size());
+    for (size_t i = 0; i < order.size(); ++i)
+      order[i] = i;
+
+    // Sorted by name, and by position for equal names.
+    std::sort(order.begin(), order.end(), [&def](size_t lhs, size_t rhs)
+    {
+      const ASCIIMenus::Text &a = def.Containers[lhs].Name;
+      const ASCIIMenus::Text &b = def.Containers[rhs].Name;
+      const int cmp = memcmp(a.Data(), b.Data(), std::min(a.Size(), b.Size()));
+      if (cmp != 0)
+        return cmp < 0;
+      if (a.Size() != b.Size())
+        return a.Size() < b.Size();
+      return lhs < rhs;
+    });
+
+    for (size_t i = 1; i < order.size(); ++i)
+    {
+      const ASCIIMenus::Text &name = def.Containers[order[i]].Name;
+      const ASCIIMenus::Text &previous = def.Containers[order[i - 1]].Name;
+      if (!name.Equals(previous.Data(), previous.Size()))
+        continue;
+
+      const size_t lineNumber = 1 + std::count(data, name.Data(), '\n');
+      error = "line " + std::to_string(lineNumber) + ": menu " + name.Str() + " is already defined";
+      return false;
+    }
+
+    return true;
+  }
+
+  // Counts statements ahead of time so the flat arrays are allocated exactly once.
+  static void reserve(const char *data, size_t size, MenuDefinition &def)
+  {
+    size_t containers = 0;
+    size_t items = 0;
+    const char *end = data + size;
+    const char *line = data;
+    while (line < end)
+    {
+      const char *lineEnd = static_cast<const char *>(memchr(line, '\n', end - line));
+      if (lineEnd == nullptr)
+        lineEnd = end;
+
+      const char *c = skipSpace(line, lineEnd);
+      if (lineEnd - c > 4 && memcmp(c, "menu", 4) == 0)
+        ++containers;
+      else if (lineEnd - c > 4 && memcmp(c, "item", 4) == 0)
+        ++items;
+
+      line = lineEnd + 1;
+    }
+
+    def.Containers.reserve(containers);
+    def.Items.reserve(items);
+  }
+
+  // Skips spaces, tabs, and carriage returns.
+  static const char *skipSpace(const char *c, const char *end)
+  {
+    while (c < end && (*c == ' ' || *c == '\t' || *c == '\r'))
+      ++c;
+    return c;
+  }
+
+  // Reads the next whitespace separated or quoted token. Returns false at end of line.
+  static bool nextToken(const char *&c, const char *end, ASCIIMenus::Text &token, bool &quoted, std::string &error)
+  {
+    c = skipSpace(c, end);
+    if (c >= end || *c == '#')
+      return false;
+
+    quoted = (*c == '"');
+    if (quoted)
+    {
+      const char *start = ++c;
+      while (c < end && *c != '"')
+        ++c;
+      if (c >= end)
+      {
+        error = "unterminated quote";
+        return false;
+      }
+      token = ASCIIMenus::Text::Borrow(start, c - start);
+      ++c;
+      return true;
+    }
+
+    const char *start = c;
+    while (c < end && *c != ' ' && *c != '\t' && *c != '\r')
+      ++c;
+    token = ASCIIMenus::Text::Borrow(start, c - start);
+    return true;
+  }
+
+  // Parses an unsigned number token.
+  static bool toNumber(const ASCIIMenus::Text &token, size_t &out)
+  {
+    if (token.Empty())
+      return false;
+
+    out = 0;
+    for (size_t i = 0; i < token.Size(); ++i)
+    {
+      const char d = token.Data()[i];
+      if (d < '0' || d > '9')
+        return false;
+      out = out * 10 + static_cast<size_t>(d - '0');
+    }
+    return true;
+  }
+
+  // Parses one statement.
+  static bool parseLine(const char *c, const char *end, MenuDefinition &def, std::string &error)
+  {
+    ASCIIMenus::Text keyword;
+    bool quoted = false;
+    if (!nextToken(c, end, keyword, quoted, error))
+      return error.empty();
+
+    if (keyword == "menu")
+    {
+      MenuContainerDef con;
+      if (!nextToken(c, end, con.Name, quoted, error))
+        return fail(error, "menu needs a name");
+      con.Orientation = ASCIIMenus::VERTICAL;
+      con.X = 0;
+      con.Y = 0;
+      con.FirstItem = def.Items.size();
+      con.ItemCount = 0;
+      con.Source = ASCIIMenus::Text::Borrow(keyword.Data(), 0);
+      def.Containers.push_back(con);
+      return true;
+    }
+
+    if (def.Containers.empty())
+      return fail(error, "statement outside of a menu");
+    MenuContainerDef &con = def.Containers.back();
+
+    if (keyword == "orientation")
+    {
+      ASCIIMenus::Text value;
+      nextToken(c, end, value, quoted, error);
+      if (value == "horizontal")
+        con.Orientation = ASCIIMenus::HORIZONTAL;
+      else if (value == "vertical")
+        con.Orientation = ASCIIMenus::VERTICAL;
+      else
+        return fail(error, "orientation must be horizontal or vertical");
+      return true;
+    }
+
+    if (keyword == "position")
+    {
+      ASCIIMenus::Text x, y;
+      nextToken(c, end, x, quoted, error);
+      nextToken(c, end, y, quoted, error);
+      if (!toNumber(x, con.X) || !toNumber(y, con.Y))
+        return fail(error, "position needs two numbers");
+      return true;
+    }
+
+    if (keyword == "item")
+    {
+      MenuItemDef item;
+      if (!nextToken(c, end, item.Label, quoted, error) || !quoted)
+        return fail(error, "item needs a quoted label");
+
+      ASCIIMenus::Text token;
+      while (nextToken(c, end, token, quoted, error))
+      {
+        if (token.Size() > 1 && token.Data()[0] == '@')
+          item.Action = ASCIIMenus::Text::Borrow(token.Data() + 1, token.Size() - 1);
+        else if (item.Target.Empty())
+          item.Target = token;
+        else
+          return fail(error, "unexpected token after item target");
+      }
+      if (!error.empty())
+        return false;
+
+      def.Items.push_back(item);
+      ++con.ItemCount;
+      return true;
+    }
+
+    return fail(error, "unknown statement");
+  }
+
+  // Sets the error and returns false, for brevity.
+  static bool fail(std::string &error, const char *reason)
+  {
+    if (error.empty())
+      error = reason;
+    return false;
+  }
+};
+
+
+
+//////////////////////////////////////////////////////
+// Owns a menu file read into memory and the containers built from it. Labels in the
+// containers borrow from that memory, so the loader must outlive any menu system using
+// them. The file is read rather than mapped, so an editor rewriting it in place can't
+// pull the text out from under menus being drawn.
+//
+// Once loaded, the file can be watched for changes: inotify on Linux, modification time
+// elsewhere. Changed files are parsed on a background thread, and Poll() then rebuilds
+// only the menus whose text changed, updating the existing containers in place so menu
+// systems holding them keep their stack and selection. Unchanged menus just point their
+// labels at the new text, so the old one can go. Menus removed from the file are
+// deleted once no menu system or pending action holds them anymore.
+//////////////////////////////////////////////////////
+class MenuLoader
+{
+public:
+  // Ctor and dtor
+  MenuLoader() 
+    : path_()
+    , current_()
+    , actions_()
+    , entries_()
+    , containers_()
+    , retired_()
+    , pending_()
+    , changed_(false)
+    , watchHandle_(-1)
+    , lastModified_(0)
+    , error_() 
+  {  }
+
+  ~MenuLoader() 
+  { 
+    Unwatch();
+    if (pending_.valid())
+      pending_.wait();
+    Clear(); 
+  }
+
+  // Associates an @action name in menu files with a callback. Register before loading.
+  void RegisterAction(std::string name, ASCIIMenus::CallbackFunction function)
+  {
+    actions_.push_back(std::make_pair(std::move(name), function));
+  }
+
+  // Reads and parses the file, then creates and registers a container for each menu.
+  // Returns if it was successful; GetError() describes failures.
+  bool Load(const std::string &path)
+  {
+    Clear();
+    path_ = path;
+
+    std::shared_ptr<Generation> gen = parse(path_);
+    error_ = gen->Error;
+    if (!gen->Ok)
+      return false;
+
+    apply(gen);
+    return true;
+  }
+
+  // Deletes the containers and releases the file. Nothing may be using them anymore.
+  void Clear()
+  {
+    // Unregistered in one go, before any of them are deleted.
+    {
+      MenuRegistry::Batch batch;
+      for (Container *c : containers_)
+        MenuRegistry::Unregister(c->GetName(), c);
+    }
+    for (Container *c : containers_)
+      delete c;
+    for (Entry &e : retired_)
+      delete e.Con;
+    containers_.clear();
+    retired_.clear();
+    entries_.clear();
+    current_.reset();
+  }
+
+  // Starts watching the loaded file for changes. Returns if it was successful or not.
+  bool Watch()
+  {
+    Unwatch();
+    if (path_.empty())
+      return false;
+
+  #ifdef OS_LINUX
+    // Watch the directory, since editors often replace the file rather than write to it.
+    const size_t slash = path_.find_last_of('/');
+    const std::string dir = (slash == std::string::npos) ? "." : path_.substr(0, slash + 1);
+    watchHandle_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watchHandle_ < 0)
+      return false;
+    if (inotify_add_watch(watchHandle_, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0)
+    {
+      Unwatch();
+      return false;
+    }
+  #else
+    lastModified_ = modifiedTime(path_);
+    watchHandle_ = 0;
+  #endif
+
+    return true;
+  }
+
+  // Stops watching.
+  void Unwatch()
+  {
+  #ifdef OS_LINUX
+    if (watchHandle_ >= 0)
+      close(watchHandle_);
+  #endif
+    watchHandle_ = -1;
+  }
+
+  // Call once per frame from the UI thread. Starts a background parse when the file changed,
+  // and applies a finished one. Returns true when menus were reloaded, after which menu
+  // systems should Revalidate() since menus may have been removed. Never blocks on parsing.
+  bool Poll()
+  {
+    deleteRetired();
+
+    // A change while a parse is running is parsed again once that one is done.
+    if (fileChanged())
+      changed_ = true;
+    if (changed_ && !pending_.valid())
+      startParse();
+
+    if (!pending_.valid() || pending_.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+      return false;
+
+    std::shared_ptr<Generation> gen = pending_.get();
+    if (changed_)
+      startParse();
+
+    error_ = gen->Error;
+    if (!gen->Ok)
+      return false;
+
+    apply(gen);
+    return true;
+  }
+
+  // Accessors
+  const MenuDefinition &GetDefinition() const      { return current_->Definition; }
+  const std::vector<Container *> &GetContainers()  { return containers_; }
+  const std::string &GetError() const              { return error_; }
+  int GetWatchHandle() const                       { return watchHandle_; }
+
+private:
+  // A file read into memory and everything parsed from it.
+  struct Generation
+  {
+    MappedFile File;
+    MenuDefinition Definition;
+    std::vector<uint64_t> Hashes;
+    std::string Error;
+    bool Ok;
+  };
+
+  // A live container, the hash of the text it was built from, and the text's owner.
+  struct Entry
+  {
+    Container *Con;
+    uint64_t Hash;
+    std::shared_ptr<Generation> Source;
+  };
+
+  // Parses the file on a background thread.
+  void startParse()
+  {
+    changed_ = false;
+    pending_ = std::async(std::launch::async, &MenuLoader::parse, path_);
+  }
+
+  // Reads and parses a file, hashing each menu's text. Safe to run on any thread.
+  static std::shared_ptr<Generation> parse(std::string path)
+  {
+    std::shared_ptr<Generation> gen = std::make_shared<Generation>();
+    gen->Ok = false;
+    if (!gen->File.Read(path))
+    {
+      gen->Error = "unable to open " + path;
+      return gen;
+    }
+
+    if (!MenuParser::Parse(gen->File.Data(), gen->File.Size(), gen->Definition, gen->Error))
+    {
+      gen->Error = path + ", " + gen->Error;
+      return gen;
+    }
+
+    gen->Hashes.reserve(gen->Definition.Containers.size());
+    for (const MenuContainerDef &def : gen->Definition.Containers)
+      gen->Hashes.push_back(hash(def.Source));
+
+    gen->Ok = true;
+    return gen;
+  }
+
+  // FNV-1a over a menu's text.
+  static uint64_t hash(const ASCIIMenus::Text &text)
+  {
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < text.Size(); ++i)
+    {
+      h ^= static_cast<unsigned char>(text.Data()[i]);
+      h *= 1099511628211ULL;
+    }
+    return h;
+  }
+
+  // Swaps in a generation. Unchanged menus are rebound to its text, changed ones are rebuilt
+  // in place, new ones are created, and missing ones are unregistered and retired. All the
+  // registry changes are published together.
+  void apply(const std::shared_ptr<Generation> &gen)
+  {
+    MenuRegistry::Batch batch;
+    std::unordered_map<std::string, Entry> next;
+    next.reserve(gen->Definition.Containers.size());
+    containers_.clear();
+    containers_.reserve(gen->Definition.Containers.size());
+
+    for (size_t i = 0; i < gen->Definition.Containers.size(); ++i)
+    {
+      const MenuContainerDef &def = gen->Definition.Containers[i];
+      std::string name = def.Name.Str();
+
+      Entry entry;
+      auto old = entries_.find(name);
+      if (old != entries_.end())
+      {
+        entry = old->second;
+        entries_.erase(old);
+      }
+      else
+      {
+        entry.Con = Container::Create(name);
+        entry.Hash = gen->Hashes[i] + 1;
+      }
+
+      // Unchanged menus still borrow from the old generation, which is released once
+      // nothing is left pointing into it.
+      if (entry.Hash != gen->Hashes[i] || !rebind(entry.Con, gen->Definition, def))
+        build(entry.Con, gen->Definition, def);
+      entry.Hash = gen->Hashes[i];
+      entry.Source = gen;
+
+      containers_.push_back(entry.Con);
+      next[std::move(name)] = entry;
+    }
+
+    // Whatever is left was removed from the file.
+    for (auto &removed : entries_)
+    {
+      MenuRegistry::Unregister(removed.first, removed.second.Con);
+      retired_.push_back(removed.second);
+    }
+
+    entries_.swap(next);
+    current_ = gen;
+  }
+
+  // Fills a container from its definition. Labels and targets are borrowed, not copied.
+  void build(Container *c, const MenuDefinition &definition, const MenuContainerDef &def)
+  {
+    const size_t selected = c->GetSelectedLine();
+    c->ClearItems();
+    c->SetOrientation(def.Orientation);
+    c->SetPosition(def.X, def.Y);
+    c->ReserveItems(def.ItemCount);
+
+    for (size_t i = def.FirstItem; i < def.FirstItem + def.ItemCount; ++i)
+    {
+      const MenuItemDef &item = definition.Items[i];
+      c->AddItem(item.Label, item.Target, findAction(item.Action));
+    }
+
+    // Keep the selection where it was, if it still exists.
+    c->SetSelectedLine(def.ItemCount == 0 ? 0 : std::min(selected, def.ItemCount - 1));
+  }
+
+  // Points the labels and targets of a container at the same text in a new definition,
+  // without it counting as a change. The hash already says the text is the same, so it
+  // isn't compared again. Returns false if the items don't line up.
+  static bool rebind(Container *c, const MenuDefinition &definition, const MenuContainerDef &def)
+  {
+    std::vector<Selectable> &items = c->GetAllItems();
+    if (items.size() != def.ItemCount)
+      return false;
+
+    for (size_t i = 0; i < def.ItemCount; ++i)
+    {
+      const MenuItemDef &item = definition.Items[def.FirstItem + i];
+      items[i].Label = item.Label;
+      items[i].Target = item.Target;
+    }
+    return true;
+  }
+
+  // Looks up a registered action, nullptr if there is none.
+  ASCIIMenus::CallbackFunction findAction(const ASCIIMenus::Text &name) const
+  {
+    if (name.Empty())
+      return nullptr;
+
+    for (const auto &action : actions_)
+      if (name == action.first)
+        return action.second;
+
+    return nullptr;
+  }
+
+  // Deletes removed containers once nothing holds them, along with their hold on the text.
+  // Menu systems let go of theirs when they revalidate, and actions when they are done.
+  void deleteRetired()
+  {
+    auto kept = std::remove_if(retired_.begin(), retired_.end(), [](Entry &e)
+    {
+      if (e.Con->IsHeld())
+        return false;
+      delete e.Con;
+      return true;
+    });
+    retired_.erase(kept, retired_.end());
+  }
+
+  // Drains change notifications, returns if the watched file was among them.
+  bool fileChanged()
+  {
+    if (watchHandle_ < 0)
+      return false;
+
+  #ifdef OS_LINUX
+    const size_t slash = path_.find_last_of('/');
+    const char *file = path_.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+    bool changed = false;
+
+    alignas(struct inotify_event) char buffer[4096];
+    for (;;)
+    {
+      const ssize_t len = read(watchHandle_, buffer, sizeof(buffer));
+      if (len <= 0)
+        break;
+
+      for (ssize_t offset = 0; offset < len; )
+      {
+        const struct inotify_event *ev = reinterpret_cast<const struct inotify_event *>(buffer + offset);
+        if (ev->len > 0 && strcmp(ev->name, file) == 0)
+          changed = true;
+        offset += sizeof(struct inotify_event) + ev->len;
+      }
+    }
+
+    return changed;
+  #else
+    const time_t modified = modifiedTime(path_);
+    if (modified == lastModified_)
+      return false;
+    lastModified_ = modified;
+    return true;
+  #endif
+  }
+
+  // Last modification time of a file, 0 if it doesn't exist.
+  static time_t modifiedTime(const std::string &path)
+  {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+      return 0;
+    return info.st_mtime;
+  }
+
+  // Private variables
+  std::string path_;
+  std::shared_ptr<Generation> current_;
+  std::vector<std::pair<std::string, ASCIIMenus::CallbackFunction> > actions_;
+  std::unordered_map<std::string, Entry> entries_;
+  std::vector<Container *> containers_;
+  std::vector<Entry> retired_;
+  std::future<std::shared_ptr<Generation> > pending_;
+  bool changed_;
+  int watchHandle_;
+  time_t lastModified_;
+  std::string error_;
+};
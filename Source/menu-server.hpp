@@ -0,0 +1,802 @@
+/*!***************************************************************************
+@file    menu-server.hpp
+@author  mc-w
+@date    10/18/2026
+@brief   Serves menus to many connections from one process.
+
+The server listens on a unix socket (unix:/path/to/socket) or over TCP
+(host:port, or just a port), and gives every connection its own terminal and
+MenuSystem. Keys are read from the same socket the menus are drawn to, so any
+raw client works, for example:
+
+  socat -,raw,echo=0 unix:/tmp/menus.sock
+
+Connections are multiplexed over one epoll reactor per worker thread. A
+session stays with the worker that it was handed to, but a worker with
+nothing to do takes ready sessions from the busier ones.
+
+Every frame a session sends ends with MenuSocket::FrameEnd. LoadGenerator
+connects any number of simulated clients to a server, waits for whole frames
+by it, and reports the frame latency and throughput they saw.
+
+Linux only.
+
+@copyright (See LICENSE.md)
+*****************************************************************************/
+#pragma once
+#include "menu-system.hpp"
+
+#ifdef OS_LINUX
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <unordered_set>
+#include <cstdint>
+#include <cerrno>
+#include <csignal>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+//////////////////////////////////////////////////////
+// Socket setup shared by the server and the load generator.
+//////////////////////////////////////////////////////
+namespace MenuSocket
+{
+  // Sent after every frame. It ends synchronized output, which terminals that aren't in
+  // it or don't know it ignore, and drawing never writes it, so clients can find where
+  // each frame ends in the stream.
+  static const char FrameEnd[] = "\x1b[?2026l";
+  static const size_t FrameEndSize = sizeof(FrameEnd) - 1;
+
+  // Opens a socket for the address, either listening on it or connected to it. Returns
+  // -1 and describes why in error on failure.
+  inline int Open(const std::string &address, bool listening, std::string &error)
+  {
+    // Unix sockets
+    if (address.compare(0, 5, "unix:") == 0)
+    {
+      const std::string path = address.substr(5);
+      sockaddr_un addr = sockaddr_un();
+      if (path.size() == 0 || path.size() >= sizeof(addr.sun_path))
+      {
+        error = "Bad socket path " + path;
+        return -1;
+      }
+
+      addr.sun_family = AF_UNIX;
+      memcpy(addr.sun_path, path.c_str(), path.size());
+      const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+      if (fd < 0)
+      {
+        error = strerror(errno);
+        return -1;
+      }
+
+      if (listening)
+        unlink(path.c_str());
+
+      const int result = listening
+        ? bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr))
+        : connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+      if (result < 0 || (listening && listen(fd, SOMAXCONN) < 0))
+      {
+        error = path + ": " + strerror(errno);
+        close(fd);
+        return -1;
+      }
+
+      return fd;
+    }
+
+    // TCP, as host:port or just a port.
+    const size_t colon = address.rfind(':');
+    const std::string host = colon == std::string::npos ? "" : address.substr(0, colon);
+    const std::string port = colon == std::string::npos ? address : address.substr(colon + 1);
+
+    addrinfo hints = addrinfo();
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = listening ? AI_PASSIVE : 0;
+    addrinfo *found = nullptr;
+    const int lookup = getaddrinfo(host.size() > 0 ? host.c_str() : nullptr, port.c_str(), &hints, &found);
+    if (lookup != 0)
+    {
+      error = address + ": " + gai_strerror(lookup);
+      return -1;
+    }
+
+    int fd = -1;
+    for (addrinfo *info = found; info != nullptr; info = info->ai_next)
+    {
+      fd = socket(info->ai_family, info->ai_socktype | SOCK_CLOEXEC, info->ai_protocol);
+      if (fd < 0)
+        continue;
+
+      const int on = 1;
+      if (listening)
+      {
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (bind(fd, info->ai_addr, info->ai_addrlen) == 0 && listen(fd, SOMAXCONN) == 0)
+          break;
+      }
+      else if (connect(fd, info->ai_addr, info->ai_addrlen) == 0)
+      {
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        break;
+      }
+
+      error = address + ": " + strerror(errno);
+      close(fd);
+      fd = -1;
+    }
+
+    freeaddrinfo(found);
+    return fd;
+  }
+
+  // Switches blocking on reads and writes off.
+  inline void SetNonBlocking(int fd)
+  {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+  }
+
+  // Thousands of connections need more descriptors than the usual soft limit.
+  inline void RaiseFileLimit()
+  {
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+      limit.rlim_cur = limit.rlim_max;
+      setrlimit(RLIMIT_NOFILE, &limit);
+    }
+  }
+}
+
+
+//////////////////////////////////////////////////////
+// Runs a menu session per connection. The containers are shared by every session, each
+// only keeping its own place in them, so they must not change while serving.
+//////////////////////////////////////////////////////
+class MenuServer
+{
+public:
+  // Ctor, sessions start on the initial menu with a terminal of the given size.
+  MenuServer(std::string initial, unsigned int width = 80, unsigned int height = 24)
+    : initial_(std::move(initial))
+    , width_(width)
+    , height_(height)
+    , listener_(-1)
+    , path_()
+    , error_()
+    , workers_()
+    , running_(false)
+    , sessions_(0)
+  {  }
+
+  // Dtor, drops every session.
+  ~MenuServer()
+  {
+    Stop();
+    if (listener_ >= 0)
+      close(listener_);
+    if (path_.size() > 0)
+      unlink(path_.c_str());
+  }
+
+  // Starts listening on the address. Returns if it was successful; GetError() describes
+  // failures.
+  bool Listen(const std::string &address)
+  {
+    const int fd = MenuSocket::Open(address, true, error_);
+    if (fd < 0)
+      return false;
+
+    if (listener_ >= 0)
+      close(listener_);
+    listener_ = fd;
+    MenuSocket::SetNonBlocking(listener_);
+    path_ = address.compare(0, 5, "unix:") == 0 ? address.substr(5) : "";
+    return true;
+  }
+
+  // Starts serving on worker threads, 0 uses one per hardware thread.
+  void Start(size_t threads = 0)
+  {
+    if (running_ || listener_ < 0)
+      return;
+
+    if (threads == 0)
+      threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+
+    // Clients that go away mid frame would otherwise end the process.
+    signal(SIGPIPE, SIG_IGN);
+    MenuSocket::RaiseFileLimit();
+    running_ = true;
+    for (size_t i = 0; i < threads; ++i)
+    {
+      workers_.emplace_back(new Worker());
+      Worker &w = *workers_.back();
+
+      // Every worker may accept. Only one of them is woken per connection.
+      epoll_event ev = epoll_event();
+      ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+      ev.data.ptr = nullptr;
+      epoll_ctl(w.Epoll, EPOLL_CTL_ADD, listener_, &ev);
+
+      ev.events = EPOLLIN;
+      ev.data.ptr = &w;
+      epoll_ctl(w.Epoll, EPOLL_CTL_ADD, w.Wake, &ev);
+    }
+
+    for (std::unique_ptr<Worker> &w : workers_)
+      w->Thread = std::thread(&MenuServer::work, this, std::ref(*w));
+  }
+
+  // Stops the workers and closes every session.
+  void Stop()
+  {
+    if (!running_)
+      return;
+
+    running_ = false;
+    for (std::unique_ptr<Worker> &w : workers_)
+      wake(*w);
+    for (std::unique_ptr<Worker> &w : workers_)
+      w->Thread.join();
+
+    for (std::unique_ptr<Worker> &w : workers_)
+    {
+      for (Session *s : w->Sessions)
+      {
+        close(s->Fd);
+        delete s;
+      }
+    }
+
+    workers_.clear();
+    sessions_ = 0;
+  }
+
+  // Getters
+  size_t GetSessionCount() const          { return sessions_; }
+  const std::string &GetError() const     { return error_; }
+
+private:
+  MenuServer(const MenuServer &rhs) = delete;
+  MenuServer &operator=(const MenuServer &rhs) = delete;
+
+  // One connection. The terminal reads from and writes to the socket, and only what
+  // changed is sent.
+  struct Worker;
+  struct Session
+  {
+    Session(int fd, const std::string &initial, unsigned int width, unsigned int height, Worker *owner)
+      : Fd(fd)
+      , Sink(fd)
+      , Screen(width, height, fd, fd)
+      , Menu(initial, &Screen)
+      , Owner(owner)
+      , Turn(0)
+    {
+      Screen.SetSink(&Sink);
+      Screen.SetRetained(true);
+      Menu.SetRetained(true);
+    }
+
+    // Sends what changed as a frame.
+    void Present()
+    {
+      Screen.Update();
+      Sink.Write(MenuSocket::FrameEnd, MenuSocket::FrameEndSize);
+    }
+
+    int Fd;
+    RConsole::SocketSink Sink;
+    RConsole::Terminal Screen;
+    MenuSystem Menu;
+    Worker *Owner;
+
+    // Epoll hands a session from one worker to the next, which the memory model knows
+    // nothing about. Bumped after every turn and read before the next, to order them.
+    std::atomic<size_t> Turn;
+  };
+
+  // A reactor thread. Sessions it owns are only ever waited on here, but once ready they
+  // can be served by whichever worker takes them off the queue.
+  struct Worker
+  {
+    Worker()
+      : Epoll(epoll_create1(EPOLL_CLOEXEC))
+      , Wake(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+      , Thread()
+      , Mutex()
+      , Ready()
+      , Sessions()
+      , Count(0)
+      , Idle(false)
+    {  }
+
+    ~Worker()
+    {
+      close(Epoll);
+      close(Wake);
+    }
+
+    int Epoll;
+    int Wake;
+    std::thread Thread;
+    std::mutex Mutex;
+    std::deque<Session *> Ready;
+    std::unordered_set<Session *> Sessions;
+    std::atomic<size_t> Count;
+    std::atomic<bool> Idle;
+  };
+
+  // Worker loop.
+  void work(Worker &w)
+  {
+    const int maxEvents = 64;
+    epoll_event events[maxEvents];
+    while (running_)
+    {
+      // Only sleep when there is nothing queued up already.
+      bool queued;
+      {
+        std::lock_guard<std::mutex> lock(w.Mutex);
+        queued = !w.Ready.empty();
+      }
+
+      w.Idle = !queued;
+      const int count = epoll_wait(w.Epoll, events, maxEvents, queued ? 0 : 100);
+      w.Idle = false;
+
+      for (int i = 0; i < count; ++i)
+      {
+        void *ptr = events[i].data.ptr;
+        if (ptr == nullptr)
+          accept();
+        else if (ptr == &w)
+        {
+          uint64_t value;
+          const ssize_t drained = read(w.Wake, &value, sizeof(value));
+          UNUSED(drained);
+        }
+        else
+        {
+          std::lock_guard<std::mutex> lock(w.Mutex);
+          w.Ready.push_back(static_cast<Session *>(ptr));
+        }
+      }
+
+      // More than can be served right away, so have someone idle help out.
+      if (count > 1)
+      {
+        for (std::unique_ptr<Worker> &other : workers_)
+        {
+          if (other.get() != &w && other->Idle)
+          {
+            wake(*other);
+            break;
+          }
+        }
+      }
+
+      while (Session *s = take(w))
+        serve(s);
+    }
+  }
+
+  // The next ready session, from the front of our own queue or the back of another's.
+  Session *take(Worker &w)
+  {
+    {
+      std::lock_guard<std::mutex> lock(w.Mutex);
+      if (!w.Ready.empty())
+      {
+        Session *s = w.Ready.front();
+        w.Ready.pop_front();
+        return s;
+      }
+    }
+
+    for (std::unique_ptr<Worker> &other : workers_)
+    {
+      if (other.get() == &w)
+        continue;
+
+      std::lock_guard<std::mutex> lock(other->Mutex);
+      if (!other->Ready.empty())
+      {
+        Session *s = other->Ready.back();
+        other->Ready.pop_back();
+        return s;
+      }
+    }
+
+    return nullptr;
+  }
+
+  // Takes every waiting connection, handing each to the worker with the fewest sessions.
+  void accept()
+  {
+    for (;;)
+    {
+      // Sessions never block a worker on a client that stops reading, see serve.
+      const int fd = accept4(listener_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd < 0)
+        return;
+
+      const int on = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+      Worker *owner = workers_.front().get();
+      for (std::unique_ptr<Worker> &w : workers_)
+        if (w->Count < owner->Count)
+          owner = w.get();
+
+      Session *s = new Session(fd, initial_, width_, height_, owner);
+      s->Screen.ClearScreen();
+      s->Menu.Draw(0, 0, true);
+      s->Present();
+
+      {
+        std::lock_guard<std::mutex> lock(owner->Mutex);
+        owner->Sessions.insert(s);
+      }
+      ++owner->Count;
+      ++sessions_;
+      s->Turn.fetch_add(1, std::memory_order_release);
+      arm(s, EPOLL_CTL_ADD);
+    }
+  }
+
+  // Waits for the next input of the session, or for room to send the rest of its last
+  // frame if the client fell behind. A client that only closed its end may still read,
+  // so that is not waited on then. Only one worker gets it each time.
+  void arm(Session *s, int op)
+  {
+    epoll_event ev = epoll_event();
+    ev.events = (s->Sink.GetPending() > 0 ? EPOLLOUT : EPOLLIN | EPOLLRDHUP) | EPOLLONESHOT;
+    ev.data.ptr = s;
+    epoll_ctl(s->Owner->Epoll, op, s->Fd, &ev);
+  }
+
+  // Handles the input of a session and sends it the new frame. Input isn't read until the
+  // last frame is out, so a client that stops reading only ever has one frame queued.
+  void serve(Session *s)
+  {
+    s->Turn.load(std::memory_order_acquire);
+
+    if (!s->Sink.Flush())
+    {
+      s->Turn.fetch_add(1, std::memory_order_release);
+      arm(s, EPOLL_CTL_MOD);
+      return;
+    }
+
+    char buffer[256];
+    int count = 0;
+    bool open = true;
+    while (open && (count = s->Screen.Read(buffer, sizeof(buffer))) > 0)
+      open = handle(s->Menu, buffer, static_cast<size_t>(count));
+
+    if (!open || count < 0)
+    {
+      drop(s);
+      return;
+    }
+
+    s->Menu.Draw(0, 0, true);
+    s->Present();
+    if (!s->Sink.IsOpen())
+    {
+      drop(s);
+      return;
+    }
+
+    s->Turn.fetch_add(1, std::memory_order_release);
+    arm(s, EPOLL_CTL_MOD);
+  }
+
+  // Applies keys to a menu, like the console loop does. Returns false once the session
+  // should end: escape on the first menu, q, or selecting an item that targets exit.
+  static bool handle(MenuSystem &menu, const char *keys, size_t count)
+  {
+    for (size_t i = 0; i < count; ++i)
+    {
+      if (menu.GetDepth() == 0)
+        return false;
+
+      char c = keys[i];
+
+      // Arrow keys come in as escape [ A through D.
+      if (c == 27 && i + 2 < count && keys[i + 1] == '[')
+      {
+        i += 2;
+        c = (keys[i] == 'A' || keys[i] == 'D') ? 'w' : 's';
+      }
+
+      switch (c)
+      {
+      case 27:
+        if (menu.GetDepth() < 2)
+          return false;
+        menu.Back();
+        break;
+      case 'q':
+      case 'Q':
+        return false;
+      case 's':
+      case 'S':
+      case 'd':
+      case 'D':
+        menu.Down();
+        break;
+      case 'w':
+      case 'W':
+      case 'a':
+      case 'A':
+        menu.Up();
+        break;
+      case ' ':
+      case '\r':
+        if (menu.GetTop()->GetItemCount() > 0 && menu.GetSelected().Target == "exit")
+          return false;
+        menu.Select();
+        break;
+      }
+    }
+
+    return menu.GetDepth() > 0;
+  }
+
+  // Closes a session. It is not queued or waited on anywhere by now.
+  void drop(Session *s)
+  {
+    Worker *owner = s->Owner;
+    epoll_ctl(owner->Epoll, EPOLL_CTL_DEL, s->Fd, nullptr);
+    {
+      std::lock_guard<std::mutex> lock(owner->Mutex);
+      owner->Sessions.erase(s);
+    }
+    --owner->Count;
+    --sessions_;
+    close(s->Fd);
+    delete s;
+  }
+
+  // Interrupts a worker waiting on events.
+  static void wake(Worker &w)
+  {
+    const uint64_t one = 1;
+    const ssize_t written = write(w.Wake, &one, sizeof(one));
+    UNUSED(written);
+  }
+
+  // Private variables
+  std::string initial_;
+  unsigned int width_;
+  unsigned int height_;
+  int listener_;
+  std::string path_;
+  std::string error_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::atomic<bool> running_;
+  std::atomic<size_t> sessions_;
+};
+
+
+//////////////////////////////////////////////////////
+// Simulated clients for a menu server. Each client waits for a frame, sends a key, and
+// times how long the next frame takes to start arriving.
+//////////////////////////////////////////////////////
+class LoadGenerator
+{
+public:
+  // What the clients saw. Latencies are in milliseconds.
+  struct Report
+  {
+    size_t Clients;
+    size_t Frames;
+    double Seconds;
+    double FramesPerSecond;
+    double P50;
+    double P90;
+    double P99;
+    double Max;
+  };
+
+  // Ctor, 0 threads uses one per hardware thread.
+  LoadGenerator(std::string address, size_t clients, size_t threads = 0)
+    : address_(std::move(address))
+    , clients_(clients)
+    , threads_(threads)
+    , report_()
+    , error_()
+  {  }
+
+  // Connects every client and runs them for the given time. Returns if it was successful;
+  // GetError() describes failures.
+  bool Run(double seconds)
+  {
+    MenuSocket::RaiseFileLimit();
+    report_ = Report();
+    report_.Clients = clients_;
+
+    std::vector<int> fds;
+    fds.reserve(clients_);
+    for (size_t i = 0; i < clients_; ++i)
+    {
+      const int fd = MenuSocket::Open(address_, false, error_);
+      if (fd < 0)
+      {
+        error_ = "Client " + std::to_string(i) + ": " + error_;
+        for (int open : fds)
+          close(open);
+        return false;
+      }
+      MenuSocket::SetNonBlocking(fd);
+      fds.push_back(fd);
+    }
+
+    size_t threads = threads_;
+    if (threads == 0)
+      threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    threads = std::min(threads, std::max<size_t>(1, clients_));
+
+    const Clock::time_point start = Clock::now();
+    const Clock::time_point end = start + std::chrono::microseconds(static_cast<int64_t>(seconds * 1000000));
+    std::vector<std::vector<uint32_t>> latencies(threads);
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t)
+    {
+      const size_t first = fds.size() * t / threads;
+      const size_t last = fds.size() * (t + 1) / threads;
+      workers.emplace_back(&LoadGenerator::drive, std::vector<int>(fds.begin() + first, fds.begin() + last), end, std::ref(latencies[t]));
+    }
+    for (std::thread &worker : workers)
+      worker.join();
+
+    report_.Seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    for (int fd : fds)
+      close(fd);
+
+    // Everything in one list for the percentiles.
+    std::vector<uint32_t> all;
+    for (std::vector<uint32_t> &part : latencies)
+      all.insert(all.end(), part.begin(), part.end());
+    std::sort(all.begin(), all.end());
+
+    report_.Frames = all.size();
+    report_.FramesPerSecond = report_.Seconds > 0 ? all.size() / report_.Seconds : 0;
+    if (all.size() > 0)
+    {
+      report_.P50 = all[all.size() * 50 / 100] / 1000.0;
+      report_.P90 = all[all.size() * 90 / 100] / 1000.0;
+      report_.P99 = all[all.size() * 99 / 100] / 1000.0;
+      report_.Max = all.back() / 1000.0;
+    }
+
+    return true;
+  }
+
+  // Getters
+  const Report &GetReport() const     { return report_; }
+  const std::string &GetError() const { return error_; }
+
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  // A simulated client. The end of what it read is kept, since a frame end can be split
+  // across reads.
+  struct Client
+  {
+    int Fd;
+    bool Waiting;
+    Clock::time_point Sent;
+    char Tail[MenuSocket::FrameEndSize];
+    size_t TailSize;
+  };
+
+  // Runs a share of the clients until the end time, recording latencies in microseconds.
+  static void drive(std::vector<int> fds, Clock::time_point end, std::vector<uint32_t> &latencies)
+  {
+    const int epoll = epoll_create1(EPOLL_CLOEXEC);
+    std::vector<Client> clients;
+    clients.reserve(fds.size());
+    for (size_t i = 0; i < fds.size(); ++i)
+    {
+      // The first frame arrives on connecting, and isn't timed.
+      clients.push_back(Client{ fds[i], false, Clock::time_point(), {}, 0 });
+      epoll_event ev = epoll_event();
+      ev.events = EPOLLIN;
+      ev.data.u64 = i;
+      epoll_ctl(epoll, EPOLL_CTL_ADD, fds[i], &ev);
+    }
+
+    const int maxEvents = 256;
+    epoll_event events[maxEvents];
+    char buffer[MenuSocket::FrameEndSize + 4096];
+    const char key = 's';
+    while (Clock::now() < end)
+    {
+      const int count = epoll_wait(epoll, events, maxEvents, 10);
+      const Clock::time_point now = Clock::now();
+      for (int i = 0; i < count; ++i)
+      {
+        Client &c = clients[events[i].data.u64];
+        ssize_t got = 0;
+        size_t frames = 0;
+        for (;;)
+        {
+          memcpy(buffer, c.Tail, c.TailSize);
+          if ((got = read(c.Fd, buffer + c.TailSize, sizeof(buffer) - c.TailSize)) <= 0)
+            break;
+          frames += scan(c, buffer, c.TailSize + static_cast<size_t>(got));
+        }
+        if (got == 0)
+        {
+          epoll_ctl(epoll, EPOLL_CTL_DEL, c.Fd, nullptr);
+          continue;
+        }
+
+        // Only part of the frame is here so far.
+        if (frames == 0)
+          continue;
+
+        if (c.Waiting)
+          latencies.push_back(static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(now - c.Sent).count()));
+
+        c.Sent = Clock::now();
+        c.Waiting = write(c.Fd, &key, 1) == 1;
+      }
+    }
+
+    close(epoll);
+  }
+
+  // Counts the frame ends in what a client read, keeping whatever comes after the last one
+  // that could be the start of the next.
+  static size_t scan(Client &c, const char *data, size_t size)
+  {
+    const char *end = data + size;
+    const char *from = data;
+    size_t frames = 0;
+    for (;;)
+    {
+      const char *found = std::search(from, end, MenuSocket::FrameEnd, MenuSocket::FrameEnd + MenuSocket::FrameEndSize);
+      if (found == end)
+        break;
+      ++frames;
+      from = found + MenuSocket::FrameEndSize;
+    }
+
+    c.TailSize = std::min<size_t>(end - from, MenuSocket::FrameEndSize - 1);
+    memcpy(c.Tail, end - c.TailSize, c.TailSize);
+    return frames;
+  }
+
+  // Private variables
+  std::string address_;
+  size_t clients_;
+  size_t threads_;
+  Report report_;
+  std::string error_;
+};
+
+#endif
@@ -6,20 +6,225 @@
 
 @copyright (See LICENSE.md)
 *****************************************************************************/
+#pragma once
 #include "console-utils.hpp"
-#include <stack>
 #include <map>
 #include <string>
+#include <cstring>
 #include <vector>
+#include <algorithm>
+#include <memory>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <functional>
+#include <cstddef>
+#include <cstdint>
 
 namespace ASCIIMenus 
 {
+  // A callable taking and returning nothing, that can capture state. Callables that fit in
+  // a few pointers are stored inline without allocating. Larger ones are allocated once and
+  // shared between copies, so copying a callback never allocates.
+  class Callback
+  {
+  public:
+    // Ctors
+    Callback() : invoke_(nullptr), manage_(nullptr) {  }
+    Callback(std::nullptr_t) : invoke_(nullptr), manage_(nullptr) {  }
+
+    template <typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, Callback>::value>::type>
+    Callback(F &&function) 
+      : invoke_(nullptr)
+      , manage_(nullptr)
+    {
+      typedef typename std::decay<F>::type Stored;
+      store<Stored>(std::forward<F>(function), std::integral_constant<bool, fitsInline<Stored>()>());
+    }
+
+    Callback(const Callback &rhs) 
+      : invoke_(rhs.invoke_)
+      , manage_(rhs.manage_)
+    {
+      if (manage_ != nullptr)
+        manage_(COPY, &buffer_, const_cast<void *>(static_cast<const void *>(&rhs.buffer_)));
+    }
+
+    Callback(Callback &&rhs)
+      : invoke_(rhs.invoke_)
+      , manage_(rhs.manage_)
+    {
+      if (manage_ != nullptr)
+        manage_(MOVE, &buffer_, &rhs.buffer_);
+      rhs.invoke_ = nullptr;
+      rhs.manage_ = nullptr;
+    }
+
+    ~Callback() { reset(); }
+
+    Callback &operator=(const Callback &rhs)
+    {
+      if (&rhs != this)
+      {
+        Callback copy(rhs);
+        *this = std::move(copy);
+      }
+      return *this;
+    }
+
+    Callback &operator=(Callback &&rhs)
+    {
+      if (&rhs != this)
+      {
+        reset();
+        invoke_ = rhs.invoke_;
+        manage_ = rhs.manage_;
+        if (manage_ != nullptr)
+          manage_(MOVE, &buffer_, &rhs.buffer_);
+        rhs.invoke_ = nullptr;
+        rhs.manage_ = nullptr;
+      }
+      return *this;
+    }
+
+    // Calls the stored callable, if any.
+    void operator()()
+    {
+      if (invoke_ != nullptr)
+        invoke_(&buffer_);
+    }
+
+    // Comparison against nullptr, so it reads like the function pointer it replaced.
+    explicit operator bool() const       { return invoke_ != nullptr; }
+    bool operator==(std::nullptr_t) const { return invoke_ == nullptr; }
+    bool operator!=(std::nullptr_t) const { return invoke_ != nullptr; }
+
+  private:
+    enum Operation { COPY, MOVE, DESTROY };
+    typedef void(*Invoker)(void *);
+    typedef void(*Manager)(Operation, void *, void *);
+    typedef typename std::aligned_storage<3 * sizeof(void *), alignof(void *)>::type Buffer;
+
+    // Inline storage needs a callable that fits, and moves without throwing.
+    template <typename T>
+    static constexpr bool fitsInline()
+    {
+      return sizeof(T) <= sizeof(Buffer) && alignof(Buffer) % alignof(T) == 0 && std::is_nothrow_move_constructible<T>::value;
+    }
+
+    // Calls and manages a callable of type T held in the buffer.
+    template <typename T>
+    struct Inline
+    {
+      static void Invoke(void *buffer) { (*static_cast<T *>(buffer))(); }
+      static void Manage(Operation op, void *dst, void *src)
+      {
+        switch (op)
+        {
+        case COPY:
+          new (dst) T(*static_cast<const T *>(src));
+          break;
+        case MOVE:
+          new (dst) T(std::move(*static_cast<T *>(src)));
+          static_cast<T *>(src)->~T();
+          break;
+        case DESTROY:
+          static_cast<T *>(dst)->~T();
+          break;
+        }
+      }
+    };
+
+    // Calls a callable of type T that lives behind a shared pointer in the buffer.
+    template <typename T>
+    struct Shared
+    {
+      static void Invoke(void *buffer) { (**static_cast<std::shared_ptr<T> *>(buffer))(); }
+    };
+
+    template <typename T, typename F>
+    void store(F &&function, std::true_type)
+    {
+      new (&buffer_) T(std::forward<F>(function));
+      invoke_ = &Inline<T>::Invoke;
+      manage_ = &Inline<T>::Manage;
+    }
+
+    template <typename T, typename F>
+    void store(F &&function, std::false_type)
+    {
+      new (&buffer_) std::shared_ptr<T>(std::make_shared<T>(std::forward<F>(function)));
+      invoke_ = &Shared<T>::Invoke;
+      manage_ = &Inline<std::shared_ptr<T> >::Manage;
+    }
+
+    void reset()
+    {
+      if (manage_ != nullptr)
+        manage_(DESTROY, &buffer_, nullptr);
+      invoke_ = nullptr;
+      manage_ = nullptr;
+    }
+
+    // Private variables
+    Invoker invoke_;
+    Manager manage_;
+    Buffer buffer_;
+  };
+
   // Callback Functions
-  typedef void(*CallbackFunction)();
+  typedef Callback CallbackFunction;
 
   // Enums
-  enum ButtonState { SELECTED, NOT_SELECTED };
+  enum ButtonState { SELECTED, NOT_SELECTED, BUSY };
   enum Orientation { HORIZONTAL, VERTICAL };
+  enum DirtyState { CLEAN, SELECTION_CHANGED, REDRAW };
+
+  // Menu text that either owns its characters or borrows them from storage that outlives it,
+  // such as a mapped menu file. Borrowing lets large menu sets avoid a copy per label.
+  class Text
+  {
+  public:
+    // Ctors, owning.
+    Text()                   : owned_(), data_(nullptr), size_(0) {  }
+    Text(std::string str)    : owned_(std::move(str)), data_(nullptr), size_(0) {  }
+    Text(const char *str)    : owned_(str), data_(nullptr), size_(0) {  }
+
+    // Refers to size characters at data without copying them.
+    static Text Borrow(const char *data, size_t size)
+    {
+      Text t;
+      t.data_ = data;
+      t.size_ = size;
+      return t;
+    }
+
+    // Accessors. Note that Data() is not null terminated for borrowed text.
+    const char *Data() const { return data_ ? data_ : owned_.data(); }
+    size_t Size() const      { return data_ ? size_ : owned_.size(); }
+    bool Empty() const       { return Size() == 0; }
+    std::string Str() const  { return std::string(Data(), Size()); }
+
+    // Comparison against raw strings.
+    bool Equals(const char *str, size_t len) const { return len == Size() && memcmp(str, Data(), len) == 0; }
+    bool operator==(const char *rhs) const         { return Equals(rhs, strlen(rhs)); }
+    bool operator!=(const char *rhs) const         { return !(*this == rhs); }
+    bool operator==(const std::string &rhs) const  { return Equals(rhs.data(), rhs.size()); }
+    bool operator!=(const std::string &rhs) const  { return !(*this == rhs); }
+
+  private:
+    std::string owned_;
+    const char *data_;
+    size_t size_;
+  };
 }
 
 //////////////////////////////////////////////////////
@@ -27,32 +232,252 @@ namespace ASCIIMenus
 // represented as the name and a pointer to the container in question.
 //////////////////////////////////////////////////////
 class Container;
+
+// Something that can produce containers by name on demand, such as a mounted menu image.
+// The registry asks directories, in mount order, for names it doesn't know about. That can
+// happen on any thread looking up menus, so Find has to be safe to call concurrently.
+class ContainerDirectory
+{
+public:
+  virtual ~ContainerDirectory() {  }
+  virtual Container *Find(const std::string &name) = 0;
+};
+
+// Lookups are read-mostly and can come from any number of threads. Readers work on an
+// immutable snapshot that every thread caches, and only go back to the shared one once the
+// version moved. Changes copy the snapshot, edit the copy, and publish it, so many changes
+// at once should be made in a Batch.
 class MenuRegistry
 {
 public:
+  // Holds back the changes this thread makes while it exists, then publishes them all as
+  // one snapshot, so registering a whole file of menus copies the registry once. Batches
+  // can nest, and lookups only see the changes once the outermost one ends.
+  class Batch
+  {
+  public:
+    Batch()  { ++batchDepth_; }
+    ~Batch() { if (--batchDepth_ == 0) commit(); }
+
+  private:
+    Batch(const Batch &rhs) = delete;
+    Batch &operator=(const Batch &rhs) = delete;
+  };
+
   // Register a specific key/containtainer association. Duplicate keys override eachother.
   static void Register(std::string str, Container *con) 
   { 
-    registry_[str] = con;  
+    update([str, con](Snapshot &next) { next.Registry[str] = con; });
   }
+
+  // Removes the key, but only if it still refers to the given container. The container's
+  // slot moves on to a new generation when it is removed.
+  static void Unregister(std::string str, Container *con)
+  {
+    const uint32_t slot = slotOf(con);
+    update([str, con, slot](Snapshot &next)
+    {
+      auto iter = next.Registry.find(str);
+      if (iter != next.Registry.end() && iter->second == con)
+      {
+        next.Registry.erase(iter);
+        bump(slot);
+      }
+    });
+  }
+
+  // Adds or removes a directory that is consulted for unregistered names.
+  static void Mount(ContainerDirectory *dir)   { update([dir](Snapshot &next) { next.Directories.push_back(dir); }); }
+  static void Unmount(ContainerDirectory *dir) { update([dir](Snapshot &next) { next.Directories.erase(std::remove(next.Directories.begin(), next.Directories.end(), dir), next.Directories.end()); }); }
   
   // Gets the container associted with the string key, returns null if it does not exist.
   static Container *GetContainer(std::string str)       
   { 
-    auto iter = registry_.find(str); 
-    if(iter != registry_.end())
-      return registry_[str];
+    const Snapshot &snapshot = read();
+    auto iter = snapshot.Registry.find(str); 
+    if(iter != snapshot.Registry.end())
+      return iter->second;
+
+    // Directories may register what they find, so hold on to the snapshot while asking.
+    const std::shared_ptr<const Snapshot> held = cached_;
+    for (ContainerDirectory *dir : held->Directories)
+    {
+      Container *c = dir->Find(str);
+      if (c != nullptr)
+        return c;
+    }
 
     return nullptr;
   }
 
+  // Changes every time anything is registered, unregistered, mounted or unmounted.
+  static size_t GetVersion() { return version_.load(std::memory_order_acquire); }
+
+  // Every container holds a slot for as long as it exists, a small id that finds it again
+  // by indexing the slot table, without searching names or trusting a pointer. A slot's
+  // generation moves whenever its container is deleted or unregistered, so an id and
+  // generation kept from before never find a container that has since gone or moved on.
+  static const uint32_t NoSlot = 0xFFFFFFFF;
+
+  // Hands out a free slot to a new container, and frees it when the container is deleted.
+  static uint32_t Issue(Container *con)
+  {
+    std::lock_guard<std::mutex> lock(slotMutex_);
+    uint32_t index = NoSlot;
+    if (freeSlots_.size() > 0)
+    {
+      index = freeSlots_.back();
+      freeSlots_.pop_back();
+    }
+    else if (slotCount_ < SlotsPerChunk * MaxSlotChunks)
+    {
+      index = slotCount_++;
+      if (index % SlotsPerChunk == 0)
+        slotChunks_[index / SlotsPerChunk].store(new Slot[SlotsPerChunk](), std::memory_order_release);
+    }
+
+    if (index != NoSlot)
+      slot(index).Con.store(con, std::memory_order_release);
+    return index;
+  }
+
+  static void Retire(uint32_t index)
+  {
+    if (index == NoSlot)
+      return;
+
+    std::lock_guard<std::mutex> lock(slotMutex_);
+    slot(index).Con.store(nullptr, std::memory_order_release);
+    bump(index);
+    freeSlots_.push_back(index);
+  }
+
+  // Current generation of a slot.
+  static uint32_t GetGeneration(uint32_t index)
+  {
+    return (index != NoSlot) ? slot(index).Generation.load(std::memory_order_acquire) : 0;
+  }
+
+  // The container in a slot, if the slot is still on that generation. Ids from anywhere are
+  // safe to ask for, anything out of range just isn't found.
+  static Container *GetSlot(uint32_t index, uint32_t generation)
+  {
+    if (index >= SlotsPerChunk * MaxSlotChunks)
+      return nullptr;
+    const Slot *chunk = slotChunks_[index / SlotsPerChunk].load(std::memory_order_acquire);
+    if (chunk == nullptr)
+      return nullptr;
+
+    // Checked on both sides, in case the slot is handed to a new container meanwhile.
+    const Slot &s = chunk[index % SlotsPerChunk];
+    if (s.Generation.load(std::memory_order_acquire) != generation)
+      return nullptr;
+    Container *con = s.Con.load(std::memory_order_acquire);
+    if (s.Generation.load(std::memory_order_acquire) != generation)
+      return nullptr;
+    return con;
+  }
+
 private:
+  // Slots live in chunks that are never moved or freed, so reading one needs no lock.
+  struct Slot
+  {
+    std::atomic<Container *> Con;
+    std::atomic<uint32_t> Generation;
+  };
+  static const uint32_t SlotsPerChunk = 1024;
+  static const uint32_t MaxSlotChunks = 4096;
+
+  static Slot &slot(uint32_t index)
+  {
+    return slotChunks_[index / SlotsPerChunk].load(std::memory_order_acquire)[index % SlotsPerChunk];
+  }
+
+  static void bump(uint32_t index)
+  {
+    if (index != NoSlot)
+      slot(index).Generation.fetch_add(1, std::memory_order_acq_rel);
+  }
+
+  // Defined after Container.
+  static uint32_t slotOf(Container *con);
+
+  struct Snapshot
+  {
+    std::map<std::string, Container *> Registry;
+    std::vector<ContainerDirectory *> Directories;
+  };
+
+  // The snapshot for this thread, refreshed when the version moved since it was taken.
+  static const Snapshot &read()
+  {
+    const size_t version = version_.load(std::memory_order_acquire);
+    if (cached_ == nullptr || cachedVersion_ != version)
+    {
+      cached_ = std::atomic_load_explicit(&current_, std::memory_order_acquire);
+      cachedVersion_ = version;
+    }
+
+    return *cached_;
+  }
+
+  // Publishes an edited copy of the current snapshot, or keeps the edit for later while this
+  // thread is in a batch.
+  template <typename Edit>
+  static void update(Edit edit)
+  {
+    if (batchDepth_ > 0)
+      batched_.push_back(std::move(edit));
+    else
+      publish(edit);
+  }
+
+  // Publishes everything the batch held back in one go.
+  static void commit()
+  {
+    std::vector<std::function<void(Snapshot &)>> edits;
+    edits.swap(batched_);
+    if (edits.size() > 0)
+      publish([&](Snapshot &next) { for (auto &edit : edits) edit(next); });
+  }
+
+  // Copies the current snapshot, edits it, and publishes it. Writers take turns.
+  template <typename Edit>
+  static void publish(const Edit &edit)
+  {
+    std::lock_guard<std::mutex> lock(writer_);
+    std::shared_ptr<Snapshot> next = std::make_shared<Snapshot>(*std::atomic_load_explicit(&current_, std::memory_order_acquire));
+    edit(*next);
+    std::atomic_store_explicit(&current_, std::shared_ptr<const Snapshot>(std::move(next)), std::memory_order_release);
+    version_.fetch_add(1, std::memory_order_release);
+  }
+
   // Private variables
-  static std::map<std::string, Container *> registry_;
+  static std::shared_ptr<const Snapshot> current_;
+  static std::atomic<size_t> version_;
+  static std::mutex writer_;
+  static thread_local std::shared_ptr<const Snapshot> cached_;
+  static thread_local size_t cachedVersion_;
+  static thread_local size_t batchDepth_;
+  static thread_local std::vector<std::function<void(Snapshot &)>> batched_;
+  static std::atomic<Slot *> slotChunks_[MaxSlotChunks];
+  static std::mutex slotMutex_;
+  static std::vector<uint32_t> freeSlots_;
+  static uint32_t slotCount_;
 };
 
 // Static init
-std::map<std::string, Container *> MenuRegistry::registry_ = std::map<std::string, Container *>();
+std::shared_ptr<const MenuRegistry::Snapshot> MenuRegistry::current_ = std::make_shared<const MenuRegistry::Snapshot>();
+std::atomic<size_t> MenuRegistry::version_(0);
+std::mutex MenuRegistry::writer_;
+thread_local std::shared_ptr<const MenuRegistry::Snapshot> MenuRegistry::cached_;
+thread_local size_t MenuRegistry::cachedVersion_ = 0;
+thread_local size_t MenuRegistry::batchDepth_ = 0;
+thread_local std::vector<std::function<void(MenuRegistry::Snapshot &)>> MenuRegistry::batched_;
+std::atomic<MenuRegistry::Slot *> MenuRegistry::slotChunks_[MenuRegistry::MaxSlotChunks] = {};
+std::mutex MenuRegistry::slotMutex_;
+std::vector<uint32_t> MenuRegistry::freeSlots_;
+uint32_t MenuRegistry::slotCount_ = 0;
 
 
 
@@ -62,10 +487,11 @@ std::map<std::string, Container *> MenuRegistry::registry_ = std::map<std::strin
 //////////////////////////////////////////////////////
 struct Selectable
 {
-  Selectable(std::string label, std::string target, ASCIIMenus::CallbackFunction function = nullptr)
-    : Label(label)
-    , Target(target)
-    , CallbackFunction(function)
+  Selectable(ASCIIMenus::Text label, ASCIIMenus::Text target, ASCIIMenus::CallbackFunction function = nullptr, bool async = false)
+    : Label(std::move(label))
+    , Target(std::move(target))
+    , CallbackFunction(std::move(function))
+    , Async(async)
   {  }
 
   void Call()
@@ -74,234 +500,1445 @@ struct Selectable
       CallbackFunction();
   }
 
-  std::string Label;
-  std::string Target;
+  ASCIIMenus::Text Label;
+  ASCIIMenus::Text Target;
   ASCIIMenus::CallbackFunction CallbackFunction;
+  bool Async;
 };
-class Container
+
+//////////////////////////////////////////////////////
+// Worker pool for actions too slow for the UI thread. Jobs run on the workers, and each
+// job's completion is queued until the UI loop picks it up with Poll, so completions run
+// on the UI thread alongside drawing.
+//////////////////////////////////////////////////////
+class ActionPool
 {
 public:
-  // Effective ctor, registers the name for you. Deallocation needed after.
-  static Container *Create(std::string menuName) 
-  { 
-    Container *c = new Container(menuName);
-    MenuRegistry::Register(menuName, c); 
-    return c;
-  }
+  // Ctor, 0 threads uses one per hardware thread.
+  ActionPool(size_t threads = 0)
+    : jobs_()
+    , done_()
+    , mutex_()
+    , wake_()
+    , running_(true)
+    , workers_()
+  {
+    if (threads == 0)
+      threads = std::max<size_t>(1, std::thread::hardware_concurrency());
 
-  // Member functions
-  void AddItem(std::string label, std::string target, ASCIIMenus::CallbackFunction function = nullptr) 
-  { 
-    lineItems_.push_back(Selectable(label, target, function)); 
+    workers_.reserve(threads);
+    for (size_t i = 0; i < threads; ++i)
+      workers_.emplace_back(&ActionPool::work, this);
   }
-  
-  // Setter
-  void SetOrientation(ASCIIMenus::Orientation o)   { orientation_ = o;  }
-  void SetPosition(size_t x, size_t y) { x_ = x; y_ = y;    }
-  void SetSelectedLine(size_t line) { selected_ = line; }
-
-  // Accessors
-  std::vector<Selectable> &GetAllItems()   { return lineItems_; }
-  ASCIIMenus::Orientation GetOrientation() { return orientation_; }
-  Selectable GetSelected()                 { return lineItems_[selected_]; }
-  size_t GetSelectedLine()                 { return selected_; }
-  size_t GetXPos()                         { return x_; }
-  size_t GetYPos()                         { return y_; }
 
+  // Dtor, waits on jobs already running. Queued jobs and completions are dropped.
+  ~ActionPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      running_ = false;
+    }
+    wake_.notify_all();
+    for (std::thread &worker : workers_)
+      worker.join();
+  }
 
-  // Changes to next selection, with wrapping.
-  void Next() 
-  { 
-    ++selected_; 
-    if(selected_ > lineItems_.size() - 1) 
-      selected_ = 0; 
+  // Queues a job. Once it ran, done is handed to the next Poll.
+  void Submit(ASCIIMenus::Callback job, ASCIIMenus::Callback done = nullptr)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      jobs_.push_back(Job{ std::move(job), std::move(done) });
+    }
+    wake_.notify_one();
   }
 
-  // Changes to previous selection, with wrapping.
-  void Prev() 
-  { 
-    if(selected_ == 0) 
-      selected_ = lineItems_.size() - 1; 
-    else
-      --selected_; 
+  // Runs the completions of finished jobs. Call from the UI loop. Returns how many ran.
+  size_t Poll()
+  {
+    std::vector<ASCIIMenus::Callback> done;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (done_.empty())
+        return 0;
+      done.swap(done_);
+    }
+
+    for (ASCIIMenus::Callback &callback : done)
+      callback();
+    return done.size();
   }
 
 private:
-  // Private ctor
-    Container(std::string menuName) 
-    : selected_(0)
-    , name_(menuName)
-    , lineItems_()
-    , orientation_(ASCIIMenus::Orientation::VERTICAL)
-    , x_(0)
-    , y_(0)
-  {  }
+  ActionPool(const ActionPool &rhs) = delete;
+  ActionPool &operator=(const ActionPool &rhs) = delete;
+
+  struct Job
+  {
+    ASCIIMenus::Callback Run;
+    ASCIIMenus::Callback Done;
+  };
+
+  // Worker loop.
+  void work()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;)
+    {
+      wake_.wait(lock, [this]() { return !running_ || !jobs_.empty(); });
+      if (!running_)
+        return;
+
+      Job job = std::move(jobs_.front());
+      jobs_.pop_front();
+      lock.unlock();
+      job.Run();
+      lock.lock();
+
+      if (job.Done != nullptr)
+        done_.push_back(std::move(job.Done));
+    }
+  }
 
   // Private variables
-  size_t selected_;
-  std::string name_;
-  std::vector<Selectable> lineItems_;
-  ASCIIMenus::Orientation orientation_;
-  size_t x_;
-  size_t y_;
+  std::deque<Job> jobs_;
+  std::vector<ASCIIMenus::Callback> done_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool running_;
+  std::vector<std::thread> workers_;
 };
 
 
+// Where an item is drawn, relative to where the menu is drawn.
+struct ItemRect
+{
+  size_t X;
+  size_t Y;
+  size_t Width;
+  size_t Height;
+};
+
 
 //////////////////////////////////////////////////////
-// Stack-based menu system. Uses a stack of different menu containers
-// to display the most recently navigated to on the top when draw is called.
+// Lazy item providers. Instead of pushing every item up front, a container can be backed
+// by a provider that reports a count and fills in ranges of items when they are needed.
 //////////////////////////////////////////////////////
-class MenuSystem
+class ItemProvider
 {
-private:
+public:
+  virtual ~ItemProvider() {  }
 
-  // Pushes a continer to the stack if possible.
-  void pushContainer(Container *c)
+  // Total number of items. Called from the UI thread, so keep it cheap.
+  virtual size_t Count() = 0;
+
+  // Appends items [first, first + count) to out. Called from the page worker thread.
+  virtual void Fetch(size_t first, size_t count, std::vector<Selectable> &out) = 0;
+};
+
+// Synchronous, read-only item storage that a container can sit directly on top of, such as
+// a precompiled menu image. Unlike a provider, every item is available immediately.
+class ItemSource
+{
+public:
+  virtual ~ItemSource() {  }
+
+  // Number of items and a specific item of the container with the given id.
+  virtual size_t Count(size_t id) const = 0;
+  virtual Selectable Get(size_t id, size_t index) const = 0;
+
+  // The container an item leads to, when the source already knows it. Null otherwise, and
+  // the target is looked up by name.
+  virtual Container *Target(size_t id, size_t index) const { (void)id; (void)index; return nullptr; }
+};
+
+// Bounded LRU cache of provider pages. Pages that are not resident are queued for a
+// background worker, and a placeholder item is handed out until the page arrives. Menu
+// systems on different threads can read through the same cache.
+class PagedItemCache
+{
+public:
+  // Ctor and dtor. The worker thread lives as long as the cache does.
+  PagedItemCache(ItemProvider *provider, size_t pageSize, size_t maxPages)
+    : provider_(provider)
+    , pageSize_(pageSize > 0 ? pageSize : 1)
+    , maxPages_(maxPages > 0 ? maxPages : 1)
+    , placeholder_("...", "")
+    , pages_()
+    , lookup_()
+    , requests_()
+    , inFlight_()
+    , finished_()
+    , lru_()
+    , mutex_()
+    , wake_()
+    , running_(true)
+    , worker_()
+  {
+    worker_ = std::thread(&PagedItemCache::work, this);
+  }
+
+  ~PagedItemCache()
   {
-    stack_.top()->GetSelected().Call();
-    if (c == nullptr)
     {
-      if (stack_.top()->GetSelected().Target == "back")
-        stack_.pop();
+      std::lock_guard<std::mutex> lock(mutex_);
+      running_ = false;
     }
-    else
-      stack_.push(c);
+    wake_.notify_all();
+    worker_.join();
   }
 
-  // Drawing a menu item at a location
-  void drawItem(size_t x, size_t y, std::string str, ASCIIMenus::ButtonState buttonState)
+  // Setter
+  void SetPlaceholder(std::string label) { placeholder_ = Selectable(label, ""); }
+
+  // Accessors
+  size_t Count() { return provider_->Count(); }
+
+  // Gets the item at the index, or the placeholder if its page has not arrived yet.
+  Selectable Get(size_t index)
   {
-    if(buttonState == ASCIIMenus::NOT_SELECTED)
-      RConsole::Canvas::DrawString(str.c_str(), static_cast<float>(x), static_cast<float>(y), colorUnselected_);
-    else if(buttonState == ASCIIMenus::SELECTED)
-      RConsole::Canvas::DrawString(str.c_str(), static_cast<float>(x), static_cast<float>(y), colorSelected_);
+    std::lock_guard<std::mutex> lock(lru_);
+    const size_t page = index / pageSize_;
+    collect();
+
+    auto iter = lookup_.find(page);
+    if (iter == lookup_.end())
+    {
+      request(page, provider_->Count());
+      return placeholder_;
+    }
+
+    // Mark as most recently used.
+    pages_.splice(pages_.begin(), pages_, iter->second);
+    const std::vector<Selectable> &items = iter->second->Items;
+    const size_t offset = index % pageSize_;
+    if (offset < items.size())
+      return items[offset];
+
+    return placeholder_;
   }
 
-public:
-  // Ctor
-  MenuSystem(std::string initial = "")
-    : stack_()
-    , colorSelected_(RConsole::MAGENTA)
-    , colorUnselected_(RConsole::GREY)
+  // Takes in pages the worker finished. Returns if any arrived since the last call.
+  bool Refresh()
   {
-    Container *c = MenuRegistry::GetContainer(initial);
-    if (c != nullptr)
-      stack_.push(c);
+    std::lock_guard<std::mutex> lock(lru_);
+    return collect();
   }
-  
-  // Setters
-  void SetColorSelected(RConsole::Color c)   { colorSelected_ = c;   }
-  void SetColorUnselected(RConsole::Color c) { colorUnselected_ = c; }
-  
-  // Member functions
-  void Down() { stack_.top()->Next(); }
-  void Up()   { stack_.top()->Prev(); }
 
-  // Selects the currently highlighted line from the menu on the top of the stack
-  void Select() 
+  // Returns if the page holding the index is resident.
+  bool IsLoaded(size_t index)
   {
-    if(stack_.size() > 0)
-      pushContainer(MenuRegistry::GetContainer(stack_.top()->GetSelected().Target));
+    std::lock_guard<std::mutex> lock(lru_);
+    collect();
+    return lookup_.find(index / pageSize_) != lookup_.end();
   }
 
-  // Indicate a specific menu to push via name.
-  void Select(std::string manualInput)
+private:
+  struct Page
   {
-    pushContainer(MenuRegistry::GetContainer(manualInput));
-  }
+    size_t Number;
+    std::vector<Selectable> Items;
+  };
 
-  // Goes back. Returns if it did go back or not.
-  bool Back() {
-    if (stack_.size() > 0)
+  // A page to fetch, with the item count as the UI thread saw it when asking, since
+  // Count is only ever called from there.
+  struct Request
+  {
+    size_t Number;
+    size_t Count;
+  };
+
+  // Queues a page for the worker unless it is already on its way.
+  void request(size_t page, size_t count)
+  {
     {
-      stack_.pop();
-      return true;
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!inFlight_.insert(page).second)
+        return;
+      requests_.push_back(Request{ page, count });
     }
-    
-    return false;
+    wake_.notify_one();
   }
 
-  // Draws the menu
-  void Draw(size_t x = 3, size_t y = 2, bool drawAll = false)
+  // Moves pages the worker finished into the LRU, evicting the least recently used.
+  bool collect()
   {
+    std::vector<Page> done;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (finished_.empty())
+        return false;
+      done.swap(finished_);
+    }
 
-    if (stack_.size() == 0)
-      return;
+    for (Page &p : done)
+    {
+      if (lookup_.find(p.Number) != lookup_.end())
+        continue;
+
+      pages_.push_front(std::move(p));
+      lookup_[pages_.front().Number] = pages_.begin();
 
-    if(drawAll)
-      for (auto&& stackItem : stack_._Get_container())
+      if (pages_.size() > maxPages_)
       {
-        const std::vector<Selectable> &v = stackItem->GetAllItems();
-        const ASCIIMenus::Orientation o = stackItem->GetOrientation();
-        const size_t xPos = stackItem->GetXPos();
-        const size_t yPos = stackItem->GetYPos();
+        lookup_.erase(pages_.back().Number);
+        pages_.pop_back();
+      }
+    }
 
-        // Vertical menus
-        if (o == ASCIIMenus::VERTICAL)
-        {
-          for (size_t i = 0; i < v.size(); ++i)
-          {
-            if (i == stackItem->GetSelectedLine())
-              drawItem(x + xPos, i + y + yPos, v[i].Label.c_str(), ASCIIMenus::SELECTED);
-            else
-              drawItem(x + xPos, i + y + yPos, v[i].Label.c_str(), ASCIIMenus::NOT_SELECTED);
-          }
-        }
+    return true;
+  }
 
-        // Horizontal Menus
-        else if (o == ASCIIMenus::HORIZONTAL)
-        {
-          size_t xOffset = 0;
-          for (size_t i = 0; i < v.size(); ++i)
-          {
-            if (i == stackItem->GetSelectedLine())
-              drawItem(xOffset + x + xPos, y + yPos, v[i].Label.c_str(), ASCIIMenus::SELECTED);
-            else
-              drawItem(xOffset + x + xPos, y + yPos, v[i].Label.c_str(), ASCIIMenus::NOT_SELECTED);
-            xOffset += v[i].Label.size();
-          }
-        }
+  // Worker loop. Newest requests are served first so the page being looked at wins
+  // over pages that were scrolled past.
+  void work()
+  {
+    for (;;)
+    {
+      Request r;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [this]() { return !running_ || !requests_.empty(); });
+        if (!running_)
+          return;
+        r = requests_.back();
+        requests_.pop_back();
       }
 
-    // Create variables
-    const std::vector<Selectable> &v = stack_.top()->GetAllItems();
-    const ASCIIMenus::Orientation o = stack_.top()->GetOrientation();
-    const size_t xPos = stack_.top()->GetXPos();
-    const size_t yPos = stack_.top()->GetYPos();
+      Page p;
+      p.Number = r.Number;
+      p.Items.reserve(pageSize_);
+      const size_t first = r.Number * pageSize_;
+      if (first < r.Count)
+        provider_->Fetch(first, std::min(pageSize_, r.Count - first), p.Items);
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      inFlight_.erase(r.Number);
+      finished_.push_back(std::move(p));
+    }
+  }
+
+  // Private variables
+  ItemProvider *provider_;
+  size_t pageSize_;
+  size_t maxPages_;
+  Selectable placeholder_;
+  std::list<Page> pages_;
+  std::unordered_map<size_t, std::list<Page>::iterator> lookup_;
+  std::vector<Request> requests_;
+  std::unordered_set<size_t> inFlight_;
+  std::vector<Page> finished_;
+  std::mutex lru_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool running_;
+  std::thread worker_;
+};
+
 
-    // Vertical menus
-    if (o == ASCIIMenus::VERTICAL)
+
+//////////////////////////////////////////////////////
+// Menu container. Containers only describe a menu: its items, orientation and position.
+// Where a user is in it, the selection and scroll offset, is kept by each menu system, so
+// any number of them can share one set of containers, from any number of threads as long
+// as nothing is changed while they do.
+//////////////////////////////////////////////////////
+class Container
+{
+public:
+  // Effective ctor, registers the name for you. Deallocation needed after.
+  static Container *Create(std::string menuName) 
+  { 
+    Container *c = new Container(menuName);
+    MenuRegistry::Register(menuName, c); 
+    return c;
+  }
+
+  // Same, without registering, for owners that hand out their containers themselves such
+  // as a mounted image. Deallocation needed after.
+  static Container *CreateUnregistered(std::string menuName)
+  { 
+    return new Container(std::move(menuName));
+  }
+
+  // Dtor, frees the registry slot.
+  ~Container() { MenuRegistry::Retire(slot_); }
+
+  // Member functions
+  void AddItem(ASCIIMenus::Text label, ASCIIMenus::Text target, ASCIIMenus::CallbackFunction function = nullptr) 
+  { 
+    lineItems_.push_back(Selectable(std::move(label), std::move(target), std::move(function))); 
+    redraw();
+  }
+
+  // Adds an item whose function runs on the menu system's action pool. The item shows as
+  // busy in that menu system until it finishes.
+  void AddAsyncItem(ASCIIMenus::Text label, ASCIIMenus::Text target, ASCIIMenus::CallbackFunction function)
+  { 
+    lineItems_.push_back(Selectable(std::move(label), std::move(target), std::move(function), true));
+    redraw();
+  }
+
+  // Removes every added item and resets the selection.
+  void ClearItems() 
+  { 
+    lineItems_.clear(); 
+    selected_ = 0;
+    redraw();
+  }
+
+  // Reserves room for a known number of items.
+  void ReserveItems(size_t count) { lineItems_.reserve(count); }
+
+  // Backs the container with a provider instead of added items. Pages of pageSize items are
+  // fetched on demand, and at most maxPages of them are kept around. Only viewSize items
+  // around the selection are drawn, which defaults to a page. The provider is not owned.
+  void SetProvider(ItemProvider *provider, size_t pageSize = 64, size_t maxPages = 16)
+  { 
+    redraw();
+    if (provider == nullptr)
     {
-      for (size_t i = 0; i < v.size(); ++i)
-      {
-        if (i == stack_.top()->GetSelectedLine())
-          drawItem(x + xPos, i + y + yPos, v[i].Label.c_str(), ASCIIMenus::SELECTED);
-        else
-          drawItem(x + xPos, i + y + yPos, v[i].Label.c_str(), ASCIIMenus::NOT_SELECTED);
-      }
+      pages_.reset();
+      return;
     }
 
-    // Horizontal Menus
-    else if (o == ASCIIMenus::HORIZONTAL)
+    pages_.reset(new PagedItemCache(provider, pageSize, maxPages));
+    if (viewSize_ == 0)
+      viewSize_ = pageSize;
+  }
+
+  // Backs the container with items read straight from a source. The source is not owned.
+  void SetSource(const ItemSource *source, size_t id)
+  { 
+    source_ = source;
+    sourceId_ = id;
+    redraw();
+  }
+
+  // Setter. The selected line is where menu systems start when they open the container.
+  void SetOrientation(ASCIIMenus::Orientation o)   { orientation_ = o; redraw(); }
+  void SetPosition(size_t x, size_t y) { x_ = x; y_ = y; redraw(); }
+  void SetSelectedLine(size_t line) { selected_ = line; }
+  void SetViewSize(size_t items)    { viewSize_ = items; redraw(); }
+
+  // Changes the label of an added item.
+  void SetItemLabel(size_t index, ASCIIMenus::Text label)
+  { 
+    lineItems_[index].Label = std::move(label);
+    redraw();
+  }
+
+  // Accessors. Use SetItemLabel to change labels, so versions follow.
+  std::vector<Selectable> &GetAllItems()   { return lineItems_; }
+  ASCIIMenus::Orientation GetOrientation() { return orientation_; }
+  size_t GetSelectedLine()                 { return selected_; }
+  const std::string &GetName()             { return name_; }
+  size_t GetXPos()                         { return x_; }
+  size_t GetYPos()                         { return y_; }
+  size_t GetViewSize()                     { return viewSize_; }
+  bool HasProvider()                       { return pages_ != nullptr; }
+  uint32_t GetSlot() const                 { return slot_; }
+
+  // Changes whenever anything drawn changes. No two changes to any containers share a
+  // version, so caches can compare against it.
+  size_t GetVersion()
+  { 
+    refresh();
+    return version_;
+  }
+
+  // Number of items, either added or reported by the provider.
+  size_t GetItemCount()
+  { 
+    if (source_)
+      return source_->Count(sourceId_);
+    if (pages_)
+      return pages_->Count();
+    return lineItems_.size();
+  }
+
+  // The container an item leads to if its source resolved it, null if it goes by name.
+  Container *GetTarget(size_t index)
+  { 
+    return source_ ? source_->Target(sourceId_, index) : nullptr;
+  }
+
+  // Gets a specific item. Provider backed items may be a placeholder until loaded.
+  Selectable GetItem(size_t index)
+  { 
+    if (source_)
+      return source_->Get(sourceId_, index);
+    if (pages_)
+      return pages_->Get(index);
+    return lineItems_[index];
+  }
+
+  // Number of items drawn starting at a scroll offset.
+  size_t GetVisibleCount(size_t scroll)
+  { 
+    const size_t count = GetItemCount();
+    if (viewSize_ == 0 || scroll + viewSize_ > count)
+      return count - std::min(scroll, count);
+    return viewSize_;
+  }
+
+  // Lays out the visible items from a scroll offset. Vertical menus take a row each,
+  // horizontal ones sit side by side and wrap to a new row past the wrap width, 0 never
+  // wrapping.
+  void BuildLayout(size_t scroll, size_t wrapWidth, std::vector<ItemRect> &layout)
+  { 
+    const size_t count = GetVisibleCount(scroll);
+    layout.clear();
+    layout.reserve(count);
+
+    size_t col = 0;
+    size_t row = 0;
+    for (size_t i = scroll; i < scroll + count; ++i)
     {
-      size_t xOffset = 0;
-      for (size_t i = 0; i < v.size(); ++i)
-      {
-        if (i == stack_.top()->GetSelectedLine())
-          drawItem(xOffset + x + xPos, y + yPos, v[i].Label.c_str(), ASCIIMenus::SELECTED);
-        else
-          drawItem(xOffset + x + xPos, y + yPos, v[i].Label.c_str(), ASCIIMenus::NOT_SELECTED);
-        xOffset += v[i].Label.size();
+      const ASCIIMenus::Text &label = GetItem(i).Label;
+      const size_t width = RConsole::Unicode::TextWidth(label.Data(), label.Size());
+      if (orientation_ == ASCIIMenus::HORIZONTAL && wrapWidth > 0 && col > 0 && col + width > wrapWidth)
+      { 
+        col = 0;
+        ++row;
       }
+
+      ItemRect r = { x_ + col, y_ + row, width, 1 };
+      layout.push_back(r);
+      if (orientation_ == ASCIIMenus::VERTICAL)
+        ++row;
+      else
+        col += width;
     }
   }
 
+  // Returned when there is no item.
+  static const size_t NoItem = static_cast<size_t>(-1);
+
+  // Counts whoever still uses the container, see ContainerRef. Whoever owns containers
+  // keeps the ones it unregistered until nothing holds them.
+  void Hold()         { holds_.fetch_add(1, std::memory_order_relaxed); }
+  void Release()      { holds_.fetch_sub(1, std::memory_order_release); }
+  bool IsHeld() const { return holds_.load(std::memory_order_acquire) > 0; }
+
 private:
+  // Private ctor
+    Container(std::string menuName) 
+    : selected_(0)
+    , name_(menuName)
+    , lineItems_()
+    , orientation_(ASCIIMenus::Orientation::VERTICAL)
+    , x_(0)
+    , y_(0)
+    , viewSize_(0)
+    , pages_()
+    , source_(nullptr)
+    , sourceId_(0)
+    , version_(nextVersion())
+    , holds_(0)
+    , slot_(MenuRegistry::Issue(this))
+  {  }
+
+  // Versions are handed out from a single counter, so a container allocated where a deleted
+  // one used to be never matches what was cached for the old one.
+  static size_t nextVersion()
+  { 
+    static std::atomic<size_t> counter(0);
+    return ++counter;
+  }
+
+  // Everything needs drawing again.
+  void redraw()
+  { 
+    version_ = nextVersion();
+  }
+
+  // Picks up pages the provider finished loading since the last check.
+  void refresh()
+  { 
+    if (pages_ && pages_->Refresh())
+      redraw();
+  }
+
   // Private variables
-  std::stack<Container *> stack_;
-  RConsole::Color colorSelected_;
-  RConsole::Color colorUnselected_;
+  size_t selected_;
+  std::string name_;
+  std::vector<Selectable> lineItems_;
+  ASCIIMenus::Orientation orientation_;
+  size_t x_;
+  size_t y_;
+  size_t viewSize_;
+  std::unique_ptr<PagedItemCache> pages_;
+  const ItemSource *source_;
+  size_t sourceId_;
+  std::atomic<size_t> version_;
+  std::atomic<size_t> holds_;
+  uint32_t slot_;
+};
+
+inline uint32_t MenuRegistry::slotOf(Container *con)
+{
+  return con->GetSlot();
+}
+
+
+// A container pointer that holds the container while it exists, so an owner retiring the
+// container can't delete it from under whoever is still using it.
+class ContainerRef
+{
+public:
+  // Ctors and dtor
+  ContainerRef(Container *con = nullptr) : con_(con) { if (con_) con_->Hold(); }
+  ContainerRef(const ContainerRef &rhs) : ContainerRef(rhs.con_) {  }
+  ContainerRef(ContainerRef &&rhs) noexcept : con_(rhs.con_) { rhs.con_ = nullptr; }
+  ~ContainerRef() { if (con_) con_->Release(); }
+
+  // Assignment, by copy and swap.
+  ContainerRef &operator=(ContainerRef rhs) noexcept
+  {
+    std::swap(con_, rhs.con_);
+    return *this;
+  }
+
+  // Used as the pointer it holds.
+  operator Container *() const   { return con_; }
+  Container *operator->() const  { return con_; }
+
+private:
+  Container *con_;
+};
+
+
+// Where a menu system is in one container of its stack. Frames and the stack holding them
+// are all the state a menu system keeps per user; the containers themselves are shared.
+struct MenuFrame
+{
+  ContainerRef Con;
+  size_t Selected;
+  size_t Scroll;
+  size_t PrevSelected;
+  ASCIIMenus::DirtyState Dirty;
 };
 
+// Saved navigation state, see MenuSystem::SaveState. Containers are saved by registry slot
+// and generation, and by name. Restoring indexes the slot table, never following anything
+// in the state itself, and only looks the name up again when the slot moved on, so state
+// from anywhere can be restored safely.
+//
+//   [header][frames][names]
+namespace MenuStateFormat
+{
+  static const char Magic[4] = { 'A', 'M', 'S', 'T' };
+  static const uint32_t Version = 3;
+
+  struct Header
+  {
+    char Magic[4];
+    uint32_t Version;
+    uint32_t FrameCount;
+    uint32_t TotalSize;
+  };
+
+  // Names are an offset into the names block and a length.
+  struct FrameRecord
+  {
+    uint32_t Selected;
+    uint32_t Scroll;
+    uint32_t Slot;
+    uint32_t Generation;
+    uint32_t NameOffset;
+    uint32_t NameSize;
+  };
+}
+
+
+
+//////////////////////////////////////////////////////
+// Stack-based menu system. Uses a stack of different menu containers
+// to display the most recently navigated to on the top when draw is called.
+//////////////////////////////////////////////////////
+class MenuSystem
+{
+private:
+
+  // Pushes a continer to the stack if possible.
+  void pushContainer(Container *c)
+  { 
+    MenuFrame &top = stack_.back();
+    Selectable selected = top.Con->GetItem(top.Selected);
+    runAction(top.Con, top.Selected, selected);
+    if (c == nullptr)
+    {
+      if (selected.Target == "back")
+        stack_.pop_back();
+    }
+    else
+      pushFrame(c);
+  }
+
+  // Opens a container on the selection it starts on.
+  void pushFrame(Container *c)
+  { 
+    MenuFrame f = { c, c->GetSelectedLine(), 0, 0, ASCIIMenus::REDRAW };
+    stack_.push_back(f);
+    sync(stack_.back());
+  }
+
+  // Keeps a frame in range of its container, which may have changed since it was opened.
+  static void sync(MenuFrame &f)
+  { 
+    const size_t count = f.Con->GetItemCount();
+    if (f.Selected >= count)
+      f.Selected = (count > 0) ? count - 1 : 0;
+    scrollTo(f);
+  }
+
+  // Moves the selection, remembering the line that was drawn as selected.
+  static void select(MenuFrame &f, size_t line)
+  { 
+    if (line == f.Selected)
+      return;
+
+    if (f.Dirty == ASCIIMenus::CLEAN)
+    {
+      f.Dirty = ASCIIMenus::SELECTION_CHANGED;
+      f.PrevSelected = f.Selected;
+    }
+    f.Selected = line;
+    scrollTo(f);
+  }
+
+  // Keeps the selection inside the visible window. Scrolling moves every item.
+  static void scrollTo(MenuFrame &f)
+  { 
+    const size_t viewSize = f.Con->GetViewSize();
+    const size_t prevScroll = f.Scroll;
+    if (viewSize == 0)
+      f.Scroll = 0;
+    else if (f.Selected < f.Scroll)
+      f.Scroll = f.Selected;
+    else if (f.Selected >= f.Scroll + viewSize)
+      f.Scroll = f.Selected - viewSize + 1;
+
+    if (f.Scroll != prevScroll)
+      f.Dirty = ASCIIMenus::REDRAW;
+  }
+
+  // An async item of this menu system whose action is running.
+  struct BusyItem
+  { 
+    ContainerRef Con;
+    size_t Index;
+    std::shared_ptr<std::atomic<bool>> Done;
+  };
+
+  // Runs the function of an item. Async items go to the action pool if there is one, and
+  // don't run again while they are busy.
+  void runAction(Container *c, size_t index, Selectable &item)
+  { 
+    if (item.CallbackFunction == nullptr)
+      return;
+
+    if (!item.Async || pool_ == nullptr)
+    {
+      item.Call();
+      return;
+    }
+
+    collectBusy();
+    if (isBusy(c, index))
+      return;
+
+    // The completion only flags the job done, since it runs on whichever thread polls the
+    // pool. The container is held until then, even if the menu was removed meanwhile.
+    BusyItem busy = { c, index, std::make_shared<std::atomic<bool>>(false) };
+    std::shared_ptr<std::atomic<bool>> done = busy.Done;
+    busy_.push_back(std::move(busy));
+    ++busyChanges_;
+    pool_->Submit(std::move(item.CallbackFunction), [done]()
+    {
+      done->store(true, std::memory_order_release);
+    });
+  }
+
+  // Drops busy items whose job is done.
+  void collectBusy()
+  { 
+    auto done = std::remove_if(busy_.begin(), busy_.end(), [](const BusyItem &b) { return b.Done->load(std::memory_order_acquire); });
+    if (done == busy_.end())
+      return;
+
+    busy_.erase(done, busy_.end());
+    ++busyChanges_;
+  }
+
+  // Returns if an item of a container is running its action for this menu system.
+  bool isBusy(const Container *c, size_t index) const
+  { 
+    for (const BusyItem &b : busy_)
+      if (b.Con == c && b.Index == index)
+        return true;
+    return false;
+  }
+
+  // How an item of a frame should be drawn.
+  ASCIIMenus::ButtonState stateOf(const MenuFrame &f, size_t index) const
+  { 
+    if (isBusy(f.Con, index))
+      return ASCIIMenus::BUSY;
+    if (index == f.Selected)
+      return ASCIIMenus::SELECTED;
+    return ASCIIMenus::NOT_SELECTED;
+  }
+
+  // Drawing a menu item at a location
+  void drawItem(size_t x, size_t y, const ASCIIMenus::Text &str, ASCIIMenus::ButtonState buttonState)
+  { 
+    // Layers being cached are written to their raster instead, clipped to it.
+    if (target_ != nullptr)
+    {
+      if (x >= target_->GetRasterWidth() || y >= target_->GetRasterHeight())
+        return;
+
+      target_->WriteString(str.Data(), str.Size(), static_cast<float>(x), static_cast<float>(y), colorOf(buttonState));
+      return;
+    }
 
+    terminal_->DrawString(str.Data(), str.Size(), static_cast<float>(x), static_cast<float>(y), colorOf(buttonState));
+  }
+
+  // Color an item is drawn in.
+  RConsole::CellColor colorOf(ASCIIMenus::ButtonState buttonState)
+  { 
+    if (buttonState == ASCIIMenus::SELECTED)
+      return colorSelected_;
+    if (buttonState == ASCIIMenus::BUSY)
+      return colorBusy_;
+    return colorUnselected_;
+  }
+
+  // Screen area a container was last drawn to, so retained drawing can erase it.
+  struct DrawnArea
+  { 
+    Container *Con;
+    size_t X;
+    size_t Y;
+    size_t Width;
+    size_t Height;
+  };
+
+  // Composite of the bottom layers of the stack up to and including one depth.
+  struct LayerCache
+  { 
+    LayerCache(unsigned int width, unsigned int height)
+      : Con(nullptr)
+      , Version(0)
+      , Selected(0)
+      , Scroll(0)
+      , X(0)
+      , Y(0)
+      , Wrap(0)
+      , Busy(0)
+      , Stamp(0)
+      , Bounds()
+      , Raster(width, height)
+    {  }
+
+    Container *Con;
+    size_t Version;
+    size_t Selected;
+    size_t Scroll;
+    size_t X;
+    size_t Y;
+    size_t Wrap;
+    size_t Busy;
+    size_t Stamp;
+    DrawnArea Bounds;
+    RConsole::CanvasRaster Raster;
+  };
+
+  // Smallest area covering both.
+  static DrawnArea mergeAreas(const DrawnArea &a, const DrawnArea &b)
+  { 
+    if (a.Width == 0 || a.Height == 0)
+      return b;
+    if (b.Width == 0 || b.Height == 0)
+      return a;
+
+    const size_t x = std::min(a.X, b.X);
+    const size_t y = std::min(a.Y, b.Y);
+    const size_t right = std::max(a.X + a.Width, b.X + b.Width);
+    const size_t bottom = std::max(a.Y + a.Height, b.Y + b.Height);
+    DrawnArea area = { nullptr, x, y, right - x, bottom - y };
+    return area;
+  }
+
+  // Width a frame drawn at x wraps at on a canvas this wide.
+  static size_t wrapOf(const MenuFrame &f, size_t x, size_t canvasWidth)
+  { 
+    const size_t left = x + f.Con->GetXPos();
+    return (left < canvasWidth) ? canvasWidth - left : 1;
+  }
+
+  // Rectangles of the visible items of a frame drawn at x. Horizontal menus wrap instead of
+  // running off the canvas. Only rebuilt when the container, its version, the scroll or the
+  // wrap width changed since the last call.
+  const std::vector<ItemRect> &layoutOf(const MenuFrame &f, size_t x)
+  { 
+    const size_t wrapWidth = wrapOf(f, x, terminal_->GetConsoleWidht());
+    const size_t version = f.Con->GetVersion();
+    if (f.Con != layoutCon_ || version != layoutVersion_ || f.Scroll != layoutScroll_ || wrapWidth != layoutWrap_)
+    {
+      f.Con->BuildLayout(f.Scroll, wrapWidth, layout_);
+      layoutCon_ = f.Con;
+      layoutVersion_ = version;
+      layoutScroll_ = f.Scroll;
+      layoutWrap_ = wrapWidth;
+    }
+
+    return layout_;
+  }
+
+  // Draws the visible items of a frame, offset by the given location. Returns the area drawn.
+  DrawnArea drawContainer(const MenuFrame &f, size_t x, size_t y)
+  { 
+    const std::vector<ItemRect> &layout = layoutOf(f, x);
+    DrawnArea area = { f.Con, x + f.Con->GetXPos(), y + f.Con->GetYPos(), 0, 0 };
+    for (size_t i = 0; i < layout.size(); ++i)
+    {
+      const ItemRect &r = layout[i];
+      drawItem(x + r.X, y + r.Y, f.Con->GetItem(f.Scroll + i).Label, stateOf(f, f.Scroll + i));
+
+      DrawnArea itemArea = { f.Con, x + r.X, y + r.Y, r.Width, r.Height };
+      area = mergeAreas(area, itemArea);
+    }
+
+    area.Con = f.Con;
+    return area;
+  }
+
+  // Draws a single item of a frame in the same spot drawContainer would.
+  void drawSingle(const MenuFrame &f, size_t index, size_t x, size_t y)
+  { 
+    const std::vector<ItemRect> &layout = layoutOf(f, x);
+    if (index < f.Scroll || index >= f.Scroll + layout.size())
+      return;
+
+    const ItemRect &r = layout[index - f.Scroll];
+    drawItem(x + r.X, y + r.Y, f.Con->GetItem(index).Label, stateOf(f, index));
+  }
+
+  // Erases an area by drawing spaces over it.
+  void eraseArea(const DrawnArea &area)
+  { 
+    static const char spaces[] = "                                ";
+    const size_t chunk = sizeof(spaces) - 1;
+    for (size_t row = area.Y; row < area.Y + area.Height; ++row)
+      for (size_t col = area.X; col < area.X + area.Width; col += chunk)
+      { 
+        const size_t len = std::min(chunk, area.X + area.Width - col);
+        terminal_->DrawString(spaces, len, static_cast<float>(col), static_cast<float>(row), RConsole::WHITE);
+      }
+  }
+
+  // Fits a cached layer to a new canvas size. What it drew is kept if it fits in both the
+  // old and new size, otherwise some of it was or is about to be cut off, so it is drawn
+  // again.
+  static void resizeCache(LayerCache &entry, unsigned int width, unsigned int height)
+  { 
+    const DrawnArea &b = entry.Bounds;
+    const size_t fitWidth = std::min(width, entry.Raster.GetRasterWidth());
+    const size_t fitHeight = std::min(height, entry.Raster.GetRasterHeight());
+    if (b.X + b.Width > fitWidth || b.Y + b.Height > fitHeight)
+      entry.Con = nullptr;
+    entry.Raster.Reshape(width, height, RConsole::RasterInfo());
+  }
+
+  // Gets the composite of the bottom count layers of the stack. Each depth is cached on top
+  // of the one below it, and only rendered again when its layer or one underneath changed,
+  // so covering any number of layers is usually a single copy.
+  const LayerCache *underlay(size_t x, size_t y, size_t count)
+  { 
+    const unsigned int width = terminal_->GetConsoleWidht();
+    const unsigned int height = terminal_->GetConsoleHeight();
+    bool valid = true;
+    for (size_t i = 0; i < count; ++i)
+    {
+      if (i == layerCache_.size())
+        layerCache_.emplace_back(new LayerCache(width, height));
+      else if (layerCache_[i]->Raster.GetRasterWidth() != width || layerCache_[i]->Raster.GetRasterHeight() != height)
+        resizeCache(*layerCache_[i], width, height);
+
+      MenuFrame &f = stack_[i];
+      sync(f);
+      LayerCache &entry = *layerCache_[i];
+      const size_t version = f.Con->GetVersion();
+      const size_t wrap = wrapOf(f, x, width);
+      valid = valid && entry.Con == f.Con && entry.Version == version && entry.Selected == f.Selected
+        && entry.Scroll == f.Scroll && entry.X == x && entry.Y == y && entry.Wrap == wrap && entry.Busy == busyChanges_;
+      if (valid)
+        continue;
+
+      if (i == 0)
+      { 
+        entry.Raster.Zero();
+        entry.Bounds = DrawnArea();
+      }
+      else
+      { 
+        entry.Raster.CopyFrom(layerCache_[i - 1]->Raster);
+        entry.Bounds = layerCache_[i - 1]->Bounds;
+      }
+
+      target_ = &entry.Raster;
+      entry.Bounds = mergeAreas(entry.Bounds, drawContainer(f, x, y));
+      target_ = nullptr;
+
+      entry.Con = f.Con;
+      entry.Version = version;
+      entry.Selected = f.Selected;
+      entry.Scroll = f.Scroll;
+      entry.X = x;
+      entry.Y = y;
+      entry.Wrap = wrap;
+      entry.Busy = busyChanges_;
+      entry.Stamp = ++stamp_;
+    }
+
+    return layerCache_[count - 1].get();
+  }
+
+  // Draws a cached composite of layers to the canvas.
+  void drawUnderlay(const LayerCache &under)
+  { 
+    const DrawnArea &b = under.Bounds;
+    terminal_->DrawRaster(under.Raster, static_cast<unsigned int>(b.X), static_cast<unsigned int>(b.Y), static_cast<unsigned int>(b.Width), static_cast<unsigned int>(b.Height));
+  }
+
+  // If the top frame has to be drawn again since the canvas changed size. The screen keeps
+  // what was drawn where it still fits, so that is only when the items are laid out
+  // differently now, or when the old edge cut them off and there is more room.
+  bool relaidOut(const MenuFrame &f, size_t x)
+  { 
+    const size_t width = terminal_->GetConsoleWidht();
+    const size_t height = terminal_->GetConsoleHeight();
+    if (width == drawnWidth_ && height == drawnHeight_)
+      return false;
+
+    if ((width > drawnWidth_ && drawnTop_.X + drawnTop_.Width > drawnWidth_)
+      || (height > drawnHeight_ && drawnTop_.Y + drawnTop_.Height > drawnHeight_))
+      return true;
+
+    if (f.Con->GetOrientation() != ASCIIMenus::HORIZONTAL || wrapOf(f, x, width) == wrapOf(f, x, drawnWidth_))
+      return false;
+
+    const std::vector<ItemRect> &layout = layoutOf(f, x);
+    f.Con->BuildLayout(f.Scroll, wrapOf(f, x, drawnWidth_), drawnLayout_);
+    for (size_t i = 0; i < layout.size(); ++i)
+      if (layout[i].X != drawnLayout_[i].X || layout[i].Y != drawnLayout_[i].Y)
+        return true;
+    return false;
+  }
+
+  // What changed in the top frame since it was last drawn. Changes to the container itself,
+  // or to which items are busy, always mean drawing it again.
+  ASCIIMenus::DirtyState dirtyOf(const MenuFrame &f)
+  { 
+    if (f.Con->GetVersion() != drawnVersion_ || busyChanges_ != drawnBusy_)
+      return ASCIIMenus::REDRAW;
+    return f.Dirty;
+  }
+
+  // Retained drawing. Stack or offset changes, or anything changing under the top, draw
+  // everything again, otherwise only the top layer's changes are drawn: everything for
+  // structural changes, or just the old and new selected items when only the selection moved.
+  void drawRetained(size_t x, size_t y, bool drawAll)
+  { 
+    MenuFrame *top = (stack_.size() > 0) ? &stack_.back() : nullptr;
+    Container *topCon = (top != nullptr) ? top->Con : nullptr;
+    const LayerCache *under = (drawAll && stack_.size() > 1) ? underlay(x, y, stack_.size() - 1) : nullptr;
+    const size_t underStamp = (under != nullptr) ? under->Stamp : 0;
+    if (top != nullptr)
+      sync(*top);
+
+    // Redrawing the top over other layers needs them back underneath, so start over.
+    bool full = (x != drawnX_ || y != drawnY_ || topCon != drawnTop_.Con || underStamp != drawnStamp_);
+    const bool relaid = !full && top != nullptr && relaidOut(*top, x);
+    if (!full && top != nullptr && under != nullptr && (dirtyOf(*top) == ASCIIMenus::REDRAW || relaid))
+      full = true;
+    drawnWidth_ = terminal_->GetConsoleWidht();
+    drawnHeight_ = terminal_->GetConsoleHeight();
+
+    if (full)
+    {
+      eraseArea(drawnUnder_);
+      eraseArea(drawnTop_);
+      drawnUnder_ = DrawnArea();
+      drawnTop_ = DrawnArea();
+
+      if (under != nullptr)
+      { 
+        drawUnderlay(*under);
+        drawnUnder_ = under->Bounds;
+      }
+
+      if (top != nullptr)
+      { 
+        drawnTop_ = drawContainer(*top, x, y);
+        drawnVersion_ = top->Con->GetVersion();
+        drawnBusy_ = busyChanges_;
+        top->Dirty = ASCIIMenus::CLEAN;
+      }
+
+      drawnX_ = x;
+      drawnY_ = y;
+      drawnStamp_ = underStamp;
+      return;
+    }
+
+    if (top == nullptr)
+      return;
+
+    const ASCIIMenus::DirtyState dirty = dirtyOf(*top);
+    if (dirty == ASCIIMenus::REDRAW || relaid)
+    {
+      eraseArea(drawnTop_);
+      drawnTop_ = drawContainer(*top, x, y);
+    }
+    else if (dirty == ASCIIMenus::SELECTION_CHANGED)
+    {
+      drawSingle(*top, top->PrevSelected, x, y);
+      drawSingle(*top, top->Selected, x, y);
+    }
+    drawnVersion_ = top->Con->GetVersion();
+    drawnBusy_ = busyChanges_;
+    top->Dirty = ASCIIMenus::CLEAN;
+  }
+
+public:
+  // Ctor
+  MenuSystem(std::string initial = "", RConsole::Terminal *terminal = &RConsole::Canvas::Default())
+    : stack_()
+    , colorSelected_(RConsole::MAGENTA)
+    , colorUnselected_(RConsole::GREY)
+    , colorBusy_(RConsole::DARKGREY)
+    , pool_(nullptr)
+    , busy_()
+    , busyChanges_(0)
+    , retained_(false)
+    , drawnTop_()
+    , drawnUnder_()
+    , drawnX_(0)
+    , drawnY_(0)
+    , drawnStamp_(0)
+    , drawnVersion_(0)
+    , drawnBusy_(0)
+    , drawnWidth_(0)
+    , drawnHeight_(0)
+    , drawnLayout_()
+    , layerCache_()
+    , layout_()
+    , layoutCon_(nullptr)
+    , layoutVersion_(0)
+    , layoutScroll_(0)
+    , layoutWrap_(0)
+    , target_(nullptr)
+    , terminal_(terminal)
+    , stamp_(0)
+  { 
+    Container *c = MenuRegistry::GetContainer(initial);
+    if (c != nullptr)
+      pushFrame(c);
+  }
+
+  // Setters
+  void SetColorSelected(RConsole::CellColor c)   { colorSelected_ = c;   }
+  void SetColorUnselected(RConsole::CellColor c) { colorUnselected_ = c; }
+  void SetColorBusy(RConsole::CellColor c)       { colorBusy_ = c;       }
+
+  // Pool that async items run on. Without one they run right away like any other item.
+  // Call Poll on the pool regularly, so busy items get marked done. Which items are busy
+  // is kept per menu system, so one pool can serve menu systems on any threads.
+  void SetActionPool(ActionPool *pool)           { pool_ = pool;         }
+
+  // Retained mode only draws what changed since the last Draw. The terminal needs to be in
+  // retained mode too, see RConsole::Terminal::SetRetained.
+  void SetRetained(bool retained) 
+  { 
+    retained_ = retained; 
+    drawnTop_ = DrawnArea();
+    drawnUnder_ = DrawnArea();
+  }
+
+  // Terminal the menus are drawn to, the default console one unless set.
+  void SetTerminal(RConsole::Terminal *terminal)
+  { 
+    terminal_ = terminal;
+    drawnTop_ = DrawnArea();
+    drawnUnder_ = DrawnArea();
+  }
+
+  // Member functions
+  // Changes to the next selection, with wrapping.
+  void Down()
+  { 
+    if (stack_.size() == 0)
+      return;
+
+    MenuFrame &f = stack_.back();
+    sync(f);
+    const size_t count = f.Con->GetItemCount();
+    if (count > 0)
+      select(f, (f.Selected + 1 > count - 1) ? 0 : f.Selected + 1);
+  }
+
+  // Changes to the previous selection, with wrapping.
+  void Up()
+  { 
+    if (stack_.size() == 0)
+      return;
+
+    MenuFrame &f = stack_.back();
+    sync(f);
+    const size_t count = f.Con->GetItemCount();
+    if (count > 0)
+      select(f, (f.Selected == 0) ? count - 1 : f.Selected - 1);
+  }
+
+  // Selects the currently highlighted line from the menu on the top of the stack
+  void Select() 
+  { 
+    if (stack_.size() == 0)
+      return;
+
+    MenuFrame &top = stack_.back();
+    sync(top);
+    if (top.Con->GetItemCount() == 0)
+      return;
+
+    Container *target = top.Con->GetTarget(top.Selected);
+    pushContainer(target != nullptr ? target : MenuRegistry::GetContainer(GetSelected().Target.Str()));
+  }
+
+  // Indicate a specific menu to push via name.
+  void Select(std::string manualInput)
+  { 
+    Container *c = MenuRegistry::GetContainer(manualInput);
+    if (stack_.size() > 0)
+      pushContainer(c);
+    else if (c != nullptr)
+      pushFrame(c);
+  }
+
+  // The menu on the top of the stack, null when there is none, and how many are stacked.
+  Container *GetTop() const { return stack_.size() > 0 ? stack_.back().Con : nullptr; }
+  size_t GetDepth() const   { return stack_.size(); }
+
+  // The highlighted item of the top menu, which must exist.
+  Selectable GetSelected()
+  { 
+    const MenuFrame &f = stack_.back();
+    return f.Con->GetItem(f.Selected);
+  }
+  size_t GetSelectedLine() const { return stack_.size() > 0 ? stack_.back().Selected : 0; }
+
+  // Goes back. Returns if it did go back or not.
+  bool Back() {
+    if (stack_.size() > 0)
+    {
+      stack_.pop_back();
+      return true;
+    }
+
+    return false;
+  }
+
+  // Saves the stack and the place in each of its menus, replacing what is in out.
+  void SaveState(std::vector<char> &out) const
+  {
+    using namespace MenuStateFormat;
+
+    size_t namesSize = 0;
+    for (const MenuFrame &f : stack_)
+      namesSize += f.Con->GetName().size();
+
+    Header header;
+    memcpy(header.Magic, Magic, sizeof(Magic));
+    header.Version = Version;
+    header.FrameCount = static_cast<uint32_t>(stack_.size());
+    header.TotalSize = static_cast<uint32_t>(sizeof(Header) + stack_.size() * sizeof(FrameRecord) + namesSize);
+
+    out.resize(header.TotalSize);
+    char *frames = out.data() + sizeof(Header);
+    char *names = frames + stack_.size() * sizeof(FrameRecord);
+    memcpy(out.data(), &header, sizeof(Header));
+
+    uint32_t nameOffset = 0;
+    for (size_t i = 0; i < stack_.size(); ++i)
+    {
+      const MenuFrame &f = stack_[i];
+      const std::string &name = f.Con->GetName();
+      FrameRecord record;
+      record.Selected = static_cast<uint32_t>(f.Selected);
+      record.Scroll = static_cast<uint32_t>(f.Scroll);
+      record.Slot = f.Con->GetSlot();
+      record.Generation = MenuRegistry::GetGeneration(record.Slot);
+      record.NameOffset = nameOffset;
+      record.NameSize = static_cast<uint32_t>(name.size());
+      memcpy(frames + i * sizeof(FrameRecord), &record, sizeof(FrameRecord));
+      memcpy(names + nameOffset, name.data(), name.size());
+      nameOffset += record.NameSize;
+    }
+  }
+
+  // Puts back a stack saved with SaveState. Containers still in their slot are found there,
+  // the rest by name, and the stack stops below the first one that is gone. Returns false, leaving everything as it was,
+  // if the state is malformed or none of it could be restored.
+  bool RestoreState(const char *data, size_t size)
+  {
+    using namespace MenuStateFormat;
+
+    Header header;
+    if (size < sizeof(Header))
+      return false;
+    memcpy(&header, data, sizeof(Header));
+    if (memcmp(header.Magic, Magic, sizeof(Magic)) != 0 || header.Version != Version || header.TotalSize != size)
+      return false;
+
+    const uint64_t namesStart = sizeof(Header) + static_cast<uint64_t>(header.FrameCount) * sizeof(FrameRecord);
+    if (namesStart > size)
+      return false;
+
+    const char *frames = data + sizeof(Header);
+    const char *names = data + namesStart;
+    const size_t namesSize = size - static_cast<size_t>(namesStart);
+
+    std::vector<MenuFrame> restored;
+    restored.reserve(header.FrameCount);
+    for (uint32_t i = 0; i < header.FrameCount; ++i)
+    {
+      FrameRecord record;
+      memcpy(&record, frames + i * sizeof(FrameRecord), sizeof(FrameRecord));
+
+      if (static_cast<uint64_t>(record.NameOffset) + record.NameSize > namesSize)
+        return false;
+
+      // The name check catches state saved by another process, where the slot may hold a
+      // different menu.
+      const char *name = names + record.NameOffset;
+      Container *c = MenuRegistry::GetSlot(record.Slot, record.Generation);
+      if (c == nullptr || c->GetName().compare(0, std::string::npos, name, record.NameSize) != 0)
+        c = MenuRegistry::GetContainer(std::string(name, record.NameSize));
+      if (c == nullptr)
+        break;
+
+      MenuFrame f = { c, record.Selected, record.Scroll, 0, ASCIIMenus::REDRAW };
+      sync(f);
+      restored.push_back(f);
+    }
+
+    if (restored.size() == 0)
+      return false;
+
+    // Whatever was drawn before belongs to a different stack.
+    stack_.swap(restored);
+    drawnTop_.Con = nullptr;
+    return true;
+  }
+
+  // Drops any container that is no longer registered, along with everything stacked on top
+  // of it. Call after menus were reloaded or removed. Returns if the stack changed.
+  bool Revalidate()
+  { 
+    for (size_t i = 0; i < stack_.size(); ++i)
+    {
+      if (MenuRegistry::GetContainer(stack_[i].Con->GetName()) != stack_[i].Con)
+      { 
+        stack_.resize(i);
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  // Draws the menu
+  void Draw(size_t x = 3, size_t y = 2, bool drawAll = false)
+  { 
+    collectBusy();
+    if (retained_)
+    {
+      drawRetained(x, y, drawAll);
+      return;
+    }
+
+    if (stack_.size() == 0)
+      return;
+
+    // Every layer under the top comes from the cache in one copy.
+    if (drawAll && stack_.size() > 1)
+      drawUnderlay(*underlay(x, y, stack_.size() - 1));
+
+    sync(stack_.back());
+    drawContainer(stack_.back(), x, y);
+    drawnX_ = x;
+    drawnY_ = y;
+  }
+
+  // Gets the item of the top menu at a spot on the canvas where it was last drawn, or
+  // Container::NoItem.
+  size_t HitTest(size_t x, size_t y)
+  { 
+    if (stack_.size() == 0 || x < drawnX_ || y < drawnY_)
+      return Container::NoItem;
+
+    // Items are laid out row by row, left to right, so the last one starting at or before
+    // the spot is the only one that can contain it.
+    const MenuFrame &f = stack_.back();
+    const std::vector<ItemRect> &layout = layoutOf(f, drawnX_);
+    const size_t relX = x - drawnX_;
+    const size_t relY = y - drawnY_;
+    auto iter = std::upper_bound(layout.begin(), layout.end(), std::make_pair(relY, relX),
+      [](const std::pair<size_t, size_t> &spot, const ItemRect &r) 
+      { 
+        return spot.first < r.Y || (spot.first == r.Y && spot.second < r.X); 
+      });
+    if (iter == layout.begin())
+      return Container::NoItem;
+
+    --iter;
+    if (relX >= iter->X + iter->Width || relY >= iter->Y + iter->Height)
+      return Container::NoItem;
+    return f.Scroll + static_cast<size_t>(iter - layout.begin());
+  }
+
+private:
+  // Private variables
+  std::vector<MenuFrame> stack_;
+  RConsole::CellColor colorSelected_;
+  RConsole::CellColor colorUnselected_;
+  RConsole::CellColor colorBusy_;
+  ActionPool *pool_;
+  std::vector<BusyItem> busy_;
+  size_t busyChanges_;
+  bool retained_;
+  DrawnArea drawnTop_;
+  DrawnArea drawnUnder_;
+  size_t drawnX_;
+  size_t drawnY_;
+  size_t drawnStamp_;
+  size_t drawnVersion_;
+  size_t drawnBusy_;
+  size_t drawnWidth_;
+  size_t drawnHeight_;
+  std::vector<ItemRect> drawnLayout_;
+  std::vector<std::unique_ptr<LayerCache>> layerCache_;
+  std::vector<ItemRect> layout_;
+  Container *layoutCon_;
+  size_t layoutVersion_;
+  size_t layoutScroll_;
+  size_t layoutWrap_;
+  RConsole::CanvasRaster *target_;
+  RConsole::Terminal *terminal_;
+  size_t stamp_;
+};